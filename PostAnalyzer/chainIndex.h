@@ -0,0 +1,307 @@
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>> Cached index of input ntuple files >>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// TChain::GetEntries() opens every input file to count its entries,
+// which for thousands of files takes longer than the event loop start.
+// Instead, for each ntuple directory a small text file (sidecar index,
+// see ZChainIndex::IndexName) is stored with file names, modification
+// times, sizes, numbers of entries and cluster boundaries of the tree.
+// The chain is then built with known numbers of entries and files are opened
+// only when the event loop reaches them. Index entries are rebuilt
+// automatically for new files and files whose modification time or size
+// has changed. If the index can not be written (e.g. read-only directory),
+// it is kept in memory only.
+
+#ifndef TTBAR_CHAININDEX_H
+#define TTBAR_CHAININDEX_H
+
+// C++ library or ROOT header files
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <glob.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <TString.h>
+#include <TChain.h>
+#include <TFile.h>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>> ZChainIndexEntry >>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Index record of one input file.
+//
+struct ZChainIndexEntry
+{
+  ZChainIndexEntry(): MTime(0), Size(0), NEntries(0) {;}
+  long MTime; // modification time (seconds since epoch)
+  Long64_t Size; // size in bytes
+  Long64_t NEntries; // number of entries in the tree
+  std::vector<Long64_t> Clusters; // first entries of tree clusters (local numbering)
+};
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>> ZChainIndex >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// List of input files (added with file name patterns, as for TChain::Add())
+// with their numbers of entries and cluster boundaries.
+// Typical usage:
+//   ZChainIndex index("tree");
+//   index.Add("ntuples-mc/TTJets/*.root");
+//   index.AddToChain(chain);
+//
+class ZChainIndex
+{
+  public:
+    // name of the index file in each directory
+    static const char* IndexName() { return ".ztreeindex"; }
+
+    // constructor: tree name in input files
+    ZChainIndex(const TString& treeName = "tree"): zTreeName(treeName), zComplete(true) {;}
+
+    // add files matching provided pattern (wildcards are allowed in the file name only);
+    // patterns which can not be indexed (remote files, wildcards in directory names)
+    // are kept as they are and passed to TChain::Add() (see AddToChain()),
+    // in this case IsComplete() returns false
+    void Add(const TString& pattern)
+    {
+      const int slash = pattern.Last('/');
+      const TString dir = (slash >= 0) ? TString(pattern(0, slash)) : TString(".");
+      if(pattern.Contains("://") || dir.MaybeWildcard())
+      {
+        zVecFile.push_back(pattern);
+        zVecEntries.push_back(TTree::kMaxEntries);
+        zComplete = false;
+        return;
+      }
+      // list matching files (in the same order as TChain::Add() does, i.e. sorted by name)
+      std::vector<std::string> vecName;
+      glob_t g;
+      if(glob(pattern.Data(), GLOB_NOSORT, NULL, &g) == 0)
+        for(size_t f = 0; f < g.gl_pathc; f++)
+          vecName.push_back(g.gl_pathv[f]);
+      globfree(&g);
+      std::sort(vecName.begin(), vecName.end());
+      if(vecName.size() == 0)
+        printf("Warning in ZChainIndex::Add(): no files match %s\n", pattern.Data());
+      // update index of this directory
+      std::map<TString, ZChainIndexEntry>& dirIndex = DirIndex(dir);
+      bool changed = false;
+      for(size_t f = 0; f < vecName.size(); f++)
+      {
+        const TString name = vecName[f].c_str();
+        const TString base = name(slash + 1, name.Length() - slash - 1);
+        struct stat st;
+        if(stat(name.Data(), &st) != 0)
+        {
+          printf("Error in ZChainIndex::Add(): can not access file %s\n", name.Data());
+          exit(1);
+        }
+        std::map<TString, ZChainIndexEntry>::iterator it = dirIndex.find(base);
+        if(it == dirIndex.end() || it->second.MTime != (long)st.st_mtime || it->second.Size != (Long64_t)st.st_size)
+        {
+          ZChainIndexEntry& entry = dirIndex[base];
+          entry.MTime = st.st_mtime;
+          entry.Size = st.st_size;
+          ReadFile(name, entry);
+          changed = true;
+        }
+        const ZChainIndexEntry& entry = dirIndex[base];
+        // files without entries are skipped (they are not needed in the chain)
+        if(entry.NEntries == 0)
+          continue;
+        zVecFile.push_back(name);
+        zVecEntries.push_back(entry.NEntries);
+        const Long64_t offset = NEntries();
+        for(size_t c = 0; c < entry.Clusters.size(); c++)
+          zVecCluster.push_back(offset + entry.Clusters[c]);
+        zTotEntries.push_back(offset + entry.NEntries);
+      }
+      if(changed)
+        Write(dir);
+    }
+
+    // add all files to provided chain: files are not opened
+    void AddToChain(TChain* chain) const
+    {
+      for(size_t f = 0; f < zVecFile.size(); f++)
+        chain->Add(zVecFile[f], zVecEntries[f]);
+    }
+
+    // true if all added patterns were indexed
+    bool IsComplete() const { return zComplete; }
+
+    // files (or not indexed patterns) in the order of the chain and their numbers of entries
+    const std::vector<TString>& Files() const { return zVecFile; }
+    const std::vector<Long64_t>& FileEntries() const { return zVecEntries; }
+
+    // total number of entries in indexed files
+    Long64_t NEntries() const { return zTotEntries.size() ? zTotEntries.back() : 0; }
+
+    // first entries of all tree clusters (global numbering in the chain, ascending);
+    // event ranges starting at these entries do not share baskets
+    const std::vector<Long64_t>& ClusterStarts() const { return zVecCluster; }
+
+  private:
+    TString zTreeName; // tree name
+    bool zComplete; // false if some patterns were not indexed
+    std::vector<TString> zVecFile; // files (or not indexed patterns) for the chain
+    std::vector<Long64_t> zVecEntries; // their numbers of entries (TTree::kMaxEntries if unknown)
+    std::vector<Long64_t> zTotEntries; // cumulative numbers of entries of indexed files
+    std::vector<Long64_t> zVecCluster; // cluster boundaries (global numbering)
+    std::map<TString, std::map<TString, ZChainIndexEntry> > zMapDir; // index per directory
+
+    // index of provided directory: read from the index file when accessed first time
+    std::map<TString, ZChainIndexEntry>& DirIndex(const TString& dir)
+    {
+      std::map<TString, std::map<TString, ZChainIndexEntry> >::iterator itDir = zMapDir.find(dir);
+      if(itDir != zMapDir.end())
+        return itDir->second;
+      std::map<TString, ZChainIndexEntry>& dirIndex = zMapDir[dir];
+      FILE* f = fopen(TString::Format("%s/%s", dir.Data(), IndexName()).Data(), "r");
+      if(!f)
+        return dirIndex;
+      char base[4096];
+      char treeName[4096];
+      // header: format version and tree name (index of other trees is ignored)
+      int version = 0;
+      if(fscanf(f, "ZChainIndex %d %4095s", &version, treeName) != 2 || version != 1 || zTreeName != treeName)
+      {
+        fclose(f);
+        return dirIndex;
+      }
+      ZChainIndexEntry entry;
+      int nClusters = 0;
+      while(fscanf(f, "%4095s %ld %lld %lld %d", base, &entry.MTime, &entry.Size, &entry.NEntries, &nClusters) == 5)
+      {
+        entry.Clusters.resize(nClusters);
+        for(int c = 0; c < nClusters; c++)
+          if(fscanf(f, "%lld", &entry.Clusters[c]) != 1)
+          {
+            // corrupted index: start from scratch
+            printf("Warning in ZChainIndex: corrupted index in %s, rebuilding\n", dir.Data());
+            dirIndex.clear();
+            fclose(f);
+            return dirIndex;
+          }
+        dirIndex[base] = entry;
+      }
+      fclose(f);
+      return dirIndex;
+    }
+
+    // read number of entries and cluster boundaries from provided file
+    void ReadFile(const TString& name, ZChainIndexEntry& entry) const
+    {
+      TFile* file = TFile::Open(name);
+      TTree* tree = (file && !file->IsZombie()) ? (TTree*)file->Get(zTreeName) : NULL;
+      if(!tree)
+      {
+        printf("Error in ZChainIndex: can not read tree %s from file %s\n", zTreeName.Data(), name.Data());
+        exit(1);
+      }
+      entry.NEntries = tree->GetEntries();
+      entry.Clusters.clear();
+      TTree::TClusterIterator it = tree->GetClusterIterator(0);
+      Long64_t start = 0;
+      while((start = it.Next()) < entry.NEntries)
+        entry.Clusters.push_back(start);
+      file->Close();
+      delete file;
+    }
+
+    // write index of provided directory (via temporary file, so that a concurrent
+    // reader never sees a partially written index)
+    void Write(const TString& dir) const
+    {
+      const std::map<TString, ZChainIndexEntry>& dirIndex = zMapDir.find(dir)->second;
+      const TString name = TString::Format("%s/%s", dir.Data(), IndexName());
+      const TString nameTmp = TString::Format("%s.%d", name.Data(), (int)getpid());
+      FILE* f = fopen(nameTmp.Data(), "w");
+      if(!f)
+      {
+        printf("Warning in ZChainIndex: can not write %s, index is not cached\n", name.Data());
+        return;
+      }
+      fprintf(f, "ZChainIndex 1 %s\n", zTreeName.Data());
+      for(std::map<TString, ZChainIndexEntry>::const_iterator it = dirIndex.begin(); it != dirIndex.end(); it++)
+      {
+        // drop removed files
+        struct stat st;
+        if(stat(TString::Format("%s/%s", dir.Data(), it->first.Data()).Data(), &st) != 0)
+          continue;
+        const ZChainIndexEntry& entry = it->second;
+        fprintf(f, "%s %ld %lld %lld %d", it->first.Data(), entry.MTime, entry.Size, entry.NEntries, (int)entry.Clusters.size());
+        for(size_t c = 0; c < entry.Clusters.size(); c++)
+          fprintf(f, " %lld", entry.Clusters[c]);
+        fprintf(f, "\n");
+      }
+      if(fclose(f) != 0 || rename(nameTmp.Data(), name.Data()) != 0)
+      {
+        printf("Warning in ZChainIndex: can not write %s, index is not cached\n", name.Data());
+        remove(nameTmp.Data());
+      }
+    }
+};
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>> Input file hash >>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// 64-bit FNV-1a hash of provided bytes (h is the hash of preceding bytes)
+inline unsigned long long HashBytes(const void* data, const size_t size, unsigned long long h = 14695981039346656037ULL)
+{
+  const unsigned char* p = (const unsigned char*)data;
+  for(size_t i = 0; i < size; i++)
+  {
+    h ^= p[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+// hash of input files matching provided patterns (as for TChain::Add()), used
+// to identify files derived from them (kinreco cache, skims): files are listed
+// and their names, sizes and modification times are hashed (remote files and
+// wildcards in directory names are hashed as patterns); h is the hash of
+// preceding data (e.g. code version)
+unsigned long long InputFilesHash(const std::vector<TString>& patterns, unsigned long long h)
+{
+  for(size_t p = 0; p < patterns.size(); p++)
+  {
+    const TString& pattern = patterns[p];
+    const int slash = pattern.Last('/');
+    const TString dir = (slash >= 0) ? TString(pattern(0, slash)) : TString(".");
+    if(pattern.Contains("://") || dir.MaybeWildcard())
+    {
+      h = HashBytes(pattern.Data(), pattern.Length() + 1, h);
+      continue;
+    }
+    std::vector<std::string> vecName;
+    glob_t g;
+    if(glob(pattern.Data(), GLOB_NOSORT, NULL, &g) == 0)
+      for(size_t f = 0; f < g.gl_pathc; f++)
+        vecName.push_back(g.gl_pathv[f]);
+    globfree(&g);
+    std::sort(vecName.begin(), vecName.end());
+    for(size_t f = 0; f < vecName.size(); f++)
+    {
+      struct stat st;
+      if(stat(vecName[f].c_str(), &st) != 0)
+        continue;
+      const long long size = st.st_size;
+      const long long mtime = st.st_mtime;
+      h = HashBytes(vecName[f].c_str(), vecName[f].size() + 1, h);
+      h = HashBytes(&size, sizeof(size), h);
+      h = HashBytes(&mtime, sizeof(mtime), h);
+    }
+  }
+  return h;
+}
+
+#endif
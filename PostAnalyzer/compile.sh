@@ -1,8 +1,19 @@
 #!/bin/bash
 
-# compile code (produces two executables)
-g++ ttbarMakeHist.cxx -o ttbarMakeHist `root-config --cflags --libs` -lMathMore -std=c++11
+# compile code (produces five executables)
+# (add -DZTREE_DEBUG to the first command to check that only active ntuple branches are read, see tree.h,
+#  add -DKINRECO_ANALYTIC_QUARTIC to use closed-form quartic equation solver in kinematic reconstruction, see kinReco.h,
+#  add -DEVENTRECO_PROFILE to measure time of event reconstruction stages, see profile.h,
+#  add -march=native to vectorise batched kinematic reconstruction with AVX2/AVX-512, see kinRecoBatch.h;
+#  -ffp-contract=off keeps batched and event by event kinematic reconstruction identical)
+g++ -O3 -ffp-contract=off ttbarMakeHist.cxx -o ttbarMakeHist `root-config --cflags --libs` -lMathMore -std=c++11 -pthread
 g++ -g ttbarMakePlots.cxx -o ttbarMakePlots `root-config --cflags --libs` -std=c++11
+# benchmark of kinematic reconstruction (optional, see ttbarBench.cxx)
+g++ -O3 -ffp-contract=off ttbarBench.cxx -o ttbarBench `root-config --cflags --libs` -lMathMore -std=c++11 -pthread
+# micro-benchmarks on synthetic events, no ntuples needed (optional, see ttbarMicroBench.cxx)
+g++ -O3 -ffp-contract=off ttbarMicroBench.cxx -o ttbarMicroBench `root-config --cflags --libs` -lMathMore -std=c++11 -pthread
+# synthetic ntuples for load tests (optional, see ttbarMakeNtuples.cxx)
+g++ -O3 ttbarMakeNtuples.cxx -o ttbarMakeNtuples `root-config --cflags --libs` -lMathMore -std=c++11
 
 # create needed directories if do not exist yet
 mkdir -p data mc hist plots
@@ -0,0 +1,163 @@
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>> Cut flow >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// Reco level event selection (see RecoEvent() in eventReco.h) is a
+// sequence of independent cuts (see ERecoCut below): the event is
+// selected if it passes all of them, so they can be applied in any order
+// (each cut reads its branches when it is applied) and the selected
+// events are the same.
+// ZCutFlow counts, for each cut, events which were tested and passed,
+// and measures the time spent in the cut (including reading of its
+// branches). In the adaptive mode the cuts are reordered periodically
+// to minimise the expected time per event: for independent cuts the
+// optimal order is ascending cost / rejection (cost is the mean time per
+// tested event, rejection the fraction of rejected events). Cuts are
+// reordered within two groups only: preselection (primary vertex,
+// trigger, dilepton) and the final cuts (MET, jets), so that the
+// preselection flag (see ZEventRecoResult in eventReco.h) has the same
+// meaning and does not depend on MET (skims, see skim.h).
+// In the adaptive mode numbers of tested and passed events of each cut
+// depend on the order of cuts, the numbers of selected events do not.
+
+#ifndef TTBAR_CUTFLOW_H
+#define TTBAR_CUTFLOW_H
+
+// C++ library or ROOT header files
+#include <cstdio>
+
+// reco level cuts in the default order
+enum ERecoCut
+{
+  kCutPV, // primary vertex
+  kCutTrig, // trigger bits
+  kCutDilep, // dilepton pair
+  kCutMET, // missing transverse energy (ee and mumu only)
+  kCutBTagAny, // at least one jet with b-tagging discriminator above threshold (fast check before jet selection)
+  kCutJets, // at least two selected jets, at least one of them b-tagged
+  kNRecoCuts // total number of cuts
+};
+
+// number of preselection cuts (they come first, the final cuts after them)
+const int kNPreselCuts = kCutMET;
+
+// cut name
+inline const char* RecoCutName(const int cut)
+{
+  static const char* names[kNRecoCuts] = { "PV", "Trigger", "Dilepton", "MET", "BTagAny", "Jets" };
+  return names[cut];
+}
+
+// true if provided cut is applied in provided decay channel (1 ee, 2 mumu, 3 emu)
+inline bool RecoCutApplies(const int cut, const int channel)
+{
+  return !(cut == kCutMET && channel == 3);
+}
+
+class ZCutFlow
+{
+  public:
+    long NEvents; // number of events
+    long NTested[kNRecoCuts]; // numbers of events tested by each cut
+    long NPassed[kNRecoCuts]; // numbers of events passed each cut
+    double Time[kNRecoCuts]; // time spent in each cut (seconds)
+
+    // constructor: if adaptive is true, cuts are reordered (see Reorder())
+    ZCutFlow(const bool adaptive = false): zAdaptive(adaptive)
+    {
+      NEvents = 0;
+      for(int c = 0; c < kNRecoCuts; c++)
+      {
+        NTested[c] = NPassed[c] = 0;
+        Time[c] = 0.0;
+        zOrder[c] = c;
+      }
+    }
+
+    // cut at provided position in the current order
+    int Order(const int i) const { return zOrder[i]; }
+
+    // account one tested event
+    void Account(const int cut, const bool pass, const double time)
+    {
+      NTested[cut]++;
+      if(pass)
+        NPassed[cut]++;
+      Time[cut] += time;
+    }
+
+    // end of event (in the adaptive mode, cuts are reordered every kReorderEvents events)
+    void EndEvent()
+    {
+      NEvents++;
+      if(zAdaptive && (NEvents % kReorderEvents) == 0)
+        Reorder();
+    }
+
+    // add counters of provided cut flow (e.g. of another thread)
+    void Add(const ZCutFlow& cutFlow)
+    {
+      NEvents += cutFlow.NEvents;
+      for(int c = 0; c < kNRecoCuts; c++)
+      {
+        NTested[c] += cutFlow.NTested[c];
+        NPassed[c] += cutFlow.NPassed[c];
+        Time[c] += cutFlow.Time[c];
+      }
+    }
+
+    // sort cuts in each group by ascending cost / rejection, if all cuts
+    // in the group were tested by at least kMinTested events
+    void Reorder()
+    {
+      ReorderGroup(0, kNPreselCuts);
+      ReorderGroup(kNPreselCuts, kNRecoCuts);
+    }
+
+    // print cut flow (cuts in the current order) for provided decay channel
+    void Print(const int channel) const
+    {
+      printf("cut flow (channel %d): %ld events%s\n", channel, NEvents, zAdaptive ? " (adaptive order)" : "");
+      for(int i = 0; i < kNRecoCuts; i++)
+      {
+        const int c = zOrder[i];
+        if(!RecoCutApplies(c, channel))
+          continue;
+        printf("  %-10s tested: %10ld   passed: %10ld   rejection: %6.2f%%   cost: %8.3f us\n", RecoCutName(c), NTested[c], NPassed[c],
+               NTested[c] ? (100.0 * (NTested[c] - NPassed[c]) / NTested[c]) : 0.0, NTested[c] ? (1e6 * Time[c] / NTested[c]) : 0.0);
+      }
+    }
+
+  private:
+    static const long kReorderEvents = 1000; // events between reorderings
+    static const long kMinTested = 100; // minimum number of tested events for reordering
+    bool zAdaptive; // if true, cuts are reordered
+    int zOrder[kNRecoCuts]; // current order of cuts
+
+    // cost / rejection of provided cut (large for cuts which reject nothing)
+    double Rank(const int cut) const
+    {
+      const double cost = Time[cut] / NTested[cut];
+      const double rejection = double(NTested[cut] - NPassed[cut]) / NTested[cut];
+      return (rejection > 0.0) ? (cost / rejection) : 1e30;
+    }
+
+    // reorder cuts at positions [first, last)
+    void ReorderGroup(const int first, const int last)
+    {
+      for(int i = first; i < last; i++)
+        if(NTested[zOrder[i]] < kMinTested)
+          return;
+      // insertion sort (stable, few cuts)
+      for(int i = first + 1; i < last; i++)
+      {
+        const int c = zOrder[i];
+        const double rank = Rank(c);
+        int j = i;
+        for(; j > first && Rank(zOrder[j - 1]) > rank; j--)
+          zOrder[j] = zOrder[j - 1];
+        zOrder[j] = c;
+      }
+    }
+};
+
+#endif
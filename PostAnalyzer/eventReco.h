@@ -8,15 +8,126 @@
 // additional files from this analysis 
 #include "tree.h"
 #include "kinReco.h"
+#include "kinRecoBatch.h"
 #include "selection.h"
 #include "settings.h"
+#include "chainIndex.h"
+#include "histoBank.h"
+#include "kinRecoCache.h"
+#include "skim.h"
+#include "preselIndex.h"
+#include "profile.h"
+#include "cutFlow.h"
 // C++ library or ROOT header files
 #include <map>
+#include <memory>
+#include <thread>
+#include <ctime>
+#include <TROOT.h>
 #include <TChain.h>
+#include <TH2D.h>
 #include <TCanvas.h>
 #include <TFile.h>
+#include <TTreeCache.h>
+#include <TStopwatch.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>> Event variables for histograms >>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Kinematic quantities used for histograms and extra cuts (see ZVarHisto 
+// and FillHistos() below) are calculated once per event and accessed by index.
+//
+enum EEventVar
+{
+  kEvPtt,    // top pT
+  kEvPtat,   // antitop pT
+  kEvPttt,   // ttbar pT
+  kEvYt,     // top rapidity
+  kEvAyt,    // top rapidity, absolute value
+  kEvYat,    // antitop rapidity
+  kEvYtt,    // ttbar rapidity
+  kEvAytt,   // ttbar rapidity, absolute value
+  kEvMtt,    // ttbar invariant mass
+  kEvDphitt, // delta phi between top and antitop
+  kEvDetatt, // delta eta between top and antitop
+  kEvPtlM,   // lepton- pT
+  kEvPtlP,   // lepton+ pT
+  kNEventVars
+};
+
+// values of all variables in one event
+struct ZEventVars
+{
+  double V[kNEventVars]; // values (see EEventVar)
+  bool HasLep; // true if lepton variables are set
+
+  // calculate all variables from top and antitop momenta, and lepton momenta (if provided)
+  void Set(const TLorentzVector* t, const TLorentzVector* tbar, const TLorentzVector* vecLepM = NULL, const TLorentzVector* vecLepP = NULL)
+  {
+    // momentum of ttbar pair
+    const TLorentzVector ttbar = *t + *tbar;
+    V[kEvPtt] = t->Pt();
+    V[kEvPtat] = tbar->Pt();
+    V[kEvPttt] = ttbar.Pt();
+    V[kEvYt] = t->Rapidity();
+    V[kEvAyt] = TMath::Abs(V[kEvYt]);
+    V[kEvYat] = tbar->Rapidity();
+    V[kEvYtt] = ttbar.Rapidity();
+    V[kEvAytt] = TMath::Abs(V[kEvYtt]);
+    V[kEvMtt] = ttbar.M();
+    V[kEvDphitt] = TMath::Abs(t->DeltaPhi(*tbar));
+    V[kEvDetatt] = TMath::Abs(t->PseudoRapidity() - tbar->PseudoRapidity());
+    HasLep = (vecLepM && vecLepP);
+    V[kEvPtlM] = HasLep ? vecLepM->Pt() : 0.0;
+    V[kEvPtlP] = HasLep ? vecLepP->Pt() : 0.0;
+  }
+};
+
+// Variable names of ZVarHisto: each variable is filled with one or two 
+// event variables (e.g. "pttat" makes two entries per event: top pT and antitop pT).
+// (you can implement more variables here if needed)
+struct ZVarHistoName
+{
+  const char* Name;
+  int Index[2]; // event variables (see EEventVar), second one -1 if not used
+};
+const ZVarHistoName kVarHistoNames[] = 
+{
+  { "ptt", { kEvPtt, -1 } },
+  { "ptat", { kEvPtat, -1 } },
+  { "pttat", { kEvPtt, kEvPtat } },
+  { "pttt", { kEvPttt, -1 } },
+  { "yt", { kEvYt, -1 } },
+  { "ayt", { kEvAyt, -1 } },
+  { "yat", { kEvYat, -1 } },
+  { "ytat", { kEvYt, kEvYat } },
+  { "ytt", { kEvYtt, -1 } },
+  { "aytt", { kEvAytt, -1 } },
+  { "mtt", { kEvMtt, -1 } },
+  { "dphitt", { kEvDphitt, -1 } },
+  { "detatt", { kEvDetatt, -1 } },
+  { "ptl", { kEvPtlM, kEvPtlP } }
+};
+const int kNVarHistoNames = sizeof(kVarHistoNames) / sizeof(kVarHistoNames[0]);
+// variables which can be used for extra cuts
+// (you can implement more cut variables here if needed)
+struct ZCutVarName
+{
+  const char* Name;
+  int Index; // event variable (see EEventVar)
+};
+const ZCutVarName kCutVarNames[] = 
+{
+  { "ayt", kEvAyt },
+  { "mtt", kEvMtt }
+};
+const int kNCutVarNames = sizeof(kCutVarNames) / sizeof(kCutVarNames[0]);
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 // >>>>>>>>>>>>>>>>>>>>>>>> ZVarHisto class >>>>>>>>>>>>>>>>>>>>>>>>>>>>
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
@@ -26,46 +137,231 @@
 // A bunch of histograms can be filled using proper ttbar kinematics 
 // input with just one line (see void FillHistos() below).
 // Also see void StoreHistos() for histogram storage.
+// Variable names are translated to event variable indices (see EEventVar above) 
+// in the constructor, so that no string comparison is done when histograms are filled.
+// For double-differential cross sections a 2D histogram can be used instead of 
+// several 1D histograms with extra cuts: x axis is the variable, y axis is the cut 
+// variable, and the event is filled with one bin lookup. When stored, it is 
+// written as 1D histograms, one per y bin (see StoreHistos()), named as the 
+// sliced 1D histograms (e.g. h_ytptt1_cs ... h_ytptt4_cs), so the output is the 
+// same for plotting.
+// The histogram given in the constructor is a prototype: it is shared (not 
+// copied) by all copies of the object, so copying histogram sets for many 
+// inputs and outputs is cheap. Each object fills its own histogram, which is 
+// created from the prototype by Instantiate() (in eventreco) and deleted in 
+// the destructor; the prototype is deleted together with its last user.
+// In eventreco histograms are filled via the histogram bank of the output 
+// (see histoBank.h and Book()), and copied to the histograms when stored.
 //
 class ZVarHisto
 {
   private:
-    TH1D* zHisto; // histogram
+    std::shared_ptr<TH1> zProto; // prototype histogram (not filled)
+    bool z2D; // true for 2D histogram
+    TH1* zHisto; // own histogram (NULL if not instantiated)
+    TH2D* zHisto2D; // the same histogram, if it is 2D (NULL otherwise)
+    TString zSliceName; // name format of stored 1D slices of 2D histogram (with %d for y bin number)
     TString zVar; // variable name (see void FillHistos() fot its usage)
     TString zCutVar; // variable to apply extra cut (for double-differential cross sections)
     double zCutMin; // minimum boundary of extra cut (for double-differential cross sections)
     double zCutMax; // maximum boundary of extra cut (for double-differential cross sections)
+    int zVarIndex[2]; // event variables to be filled (see kVarHistoNames above), -1 if not used
+    int zCutIndex; // event variable for extra cut (see kCutVarNames above), -1 if no cut
+    int zBankId; // histogram index in the bank (see Book()), -1 if not booked
+
+    // translate variable names to event variable indices
+    void SetIndices()
+    {
+      zVarIndex[0] = zVarIndex[1] = -1;
+      for(int v = 0; v < kNVarHistoNames; v++)
+        if(zVar == kVarHistoNames[v].Name)
+        {
+          zVarIndex[0] = kVarHistoNames[v].Index[0];
+          zVarIndex[1] = kVarHistoNames[v].Index[1];
+          break;
+        }
+      // unknown (not implemented) variable: histogram is not filled
+      //if(zVarIndex[0] < 0)
+      //{
+      //  printf("Error: unknown variable %s\n", zVar.Data());
+      //  exit(1);
+      //}
+      zCutIndex = -1;
+      if(zCutVar == "")
+        return;
+      for(int c = 0; c < kNCutVarNames; c++)
+        if(zCutVar == kCutVarNames[c].Name)
+        {
+          zCutIndex = kCutVarNames[c].Index;
+          break;
+        }
+      // unknown (not implemented) cut variable
+      if(zCutIndex < 0)
+      {
+        printf("Error: unknown cut variable %s\n", zCutVar.Data());
+        exit(1);
+      }
+    }
 
   public:
-    // constructor
+    // copy all settings and the prototype, but not the own histogram
+    void CopySettings(const ZVarHisto& old)
+    {
+      zProto = old.zProto;
+      z2D = old.z2D;
+      zSliceName = old.zSliceName;
+      zVar = old.zVar;
+      zCutVar = old.zCutVar;
+      zCutMin = old.zCutMin;
+      zCutMax = old.zCutMax;
+      zVarIndex[0] = old.zVarIndex[0];
+      zVarIndex[1] = old.zVarIndex[1];
+      zCutIndex = old.zCutIndex;
+      zBankId = old.zBankId;
+    }
+
+    // create own histogram as a copy of h (not attached to any directory)
+    void MakeHisto(const TH1* h)
+    {
+      if(z2D)
+        zHisto = zHisto2D = new TH2D(*((const TH2D*)h));
+      else
+      {
+        zHisto = new TH1D(*((const TH1D*)h));
+        zHisto2D = NULL;
+      }
+      zHisto->SetDirectory(0);
+    }
+
+    // take ownership of prototype histogram
+    void SetProto(TH1* h, const bool is2D)
+    {
+      h->SetDirectory(0);
+      zProto.reset(h);
+      z2D = is2D;
+      zHisto = zHisto2D = NULL;
+      zBankId = -1;
+    }
+
+    // constructor (h becomes the prototype, see above)
     ZVarHisto(const TString& str, TH1D* h)
     {
-      zHisto = h;
+      SetProto(h, false);
       zVar = str;
+      SetIndices();
     }
 
     // constructor with extra cut
     ZVarHisto(const TString& str, TH1D* h, const TString& cutVar, const double min, const double max)
     {
-      zHisto = h;
+      SetProto(h, false);
       zVar = str;
       zCutVar = cutVar;
       zCutMin = min;
       zCutMax = max;
+      SetIndices();
+    }
+
+    // constructor for 2D histogram (double-differential cross sections): 
+    // x axis for variable str, y axis for cutVar, 
+    // sliceName is name format of stored 1D slices, e.g. "h_ytptt%d_cs"
+    ZVarHisto(const TString& str, TH2D* h, const TString& cutVar, const TString& sliceName)
+    {
+      SetProto(h, true);
+      zSliceName = sliceName;
+      zVar = str;
+      zCutVar = cutVar;
+      zCutMin = h->GetYaxis()->GetXmin();
+      zCutMax = h->GetYaxis()->GetXmax();
+      SetIndices();
+      if(zCutIndex < 0)
+      {
+        printf("Error: no cut variable for 2D histogram %s\n", h->GetName());
+        exit(1);
+      }
     }
 
-    // copy constructor
+    // copy constructor (own histogram is copied only if instantiated)
     ZVarHisto(const ZVarHisto& old)
     {
-      zHisto = new TH1D(*(old.zHisto));
-      zVar = old.zVar;
-      zCutVar = old.zCutVar;
-      zCutMin = old.zCutMin;
-      zCutMax = old.zCutMax;
+      CopySettings(old);
+      zHisto = zHisto2D = NULL;
+      if(old.zHisto)
+        MakeHisto(old.zHisto);
+    }
+
+    // copy settings only, without own histogram (to be filled via the bank, see Fill())
+    ZVarHisto(const ZVarHisto& old, const bool copyHisto)
+    {
+      CopySettings(old);
+      zHisto = zHisto2D = NULL;
+      if(copyHisto && old.zHisto)
+        MakeHisto(old.zHisto);
+    }
+
+    // move constructor
+    ZVarHisto(ZVarHisto&& old)
+    {
+      CopySettings(old);
+      zHisto = old.zHisto;
+      zHisto2D = old.zHisto2D;
+      old.zHisto = old.zHisto2D = NULL;
+    }
+
+    // assignment (as copy constructor)
+    ZVarHisto& operator=(const ZVarHisto& old)
+    {
+      if(this == &old)
+        return *this;
+      delete zHisto;
+      CopySettings(old);
+      zHisto = zHisto2D = NULL;
+      if(old.zHisto)
+        MakeHisto(old.zHisto);
+      return *this;
+    }
+
+    // move assignment
+    ZVarHisto& operator=(ZVarHisto&& old)
+    {
+      if(this == &old)
+        return *this;
+      delete zHisto;
+      CopySettings(old);
+      zHisto = old.zHisto;
+      zHisto2D = old.zHisto2D;
+      old.zHisto = old.zHisto2D = NULL;
+      return *this;
+    }
+
+    // destructor: delete own histogram
+    ~ZVarHisto()
+    {
+      delete zHisto;
     }
 
-    // access histogram
-    TH1* H() {return zHisto;}
+    // create own histogram from the prototype (if not done yet); 
+    // must be called before Fill()
+    void Instantiate()
+    {
+      if(!zHisto)
+        MakeHisto(zProto.get());
+    }
+
+    // access histogram (instantiated if needed)
+    TH1* H() {Instantiate(); return zHisto;}
+
+    // access 2D histogram (NULL if histogram is 1D)
+    TH2D* H2D() {Instantiate(); return zHisto2D;}
+
+    // book histogram in the bank (to be filled via the bank, see Fill())
+    void Book(ZHistoBank& bank) {zBankId = bank.Book(H());}
+
+    // access histogram index in the bank
+    int BankId() {return zBankId;}
+
+    // access name format of stored 1D slices of 2D histogram
+    TString SliceName() {return zSliceName;}
     
     // access variable name
     TString V() {return zVar;}
@@ -78,6 +374,42 @@ class ZVarHisto
 
     // access cut maximim value
     double CutMax() {return zCutMax;}
+
+    // fill histogram with provided event variables (if the extra cut is passed) 
+    // and weight w: if bank is provided, the booked histogram in the bank 
+    // is filled (see Book()), otherwise own histogram (must be instantiated, 
+    // see Instantiate())
+    void Fill(const ZEventVars& vars, const double w, ZHistoBank* bank = NULL)
+    {
+      if(zVarIndex[0] < 0)
+        return;
+      // lepton variables (the last ones in EEventVar) are not available at generator level
+      if(!vars.HasLep && (zVarIndex[0] >= kEvPtlM || zVarIndex[1] >= kEvPtlM))
+        return;
+      // 2D histogram: the cut variable is the y axis (events outside 
+      // y range go to underflow or overflow, which are not stored)
+      if(z2D)
+      {
+        const double y = vars.V[zCutIndex];
+        for(int i = 0; i < 2 && zVarIndex[i] >= 0; i++)
+        {
+          if(bank)
+            bank->Fill(zBankId, vars.V[zVarIndex[i]], y, w);
+          else
+            zHisto2D->Fill(vars.V[zVarIndex[i]], y, w);
+        }
+        return;
+      }
+      if(zCutIndex >= 0 && (vars.V[zCutIndex] < zCutMin || vars.V[zCutIndex] > zCutMax))
+        return;
+      for(int i = 0; i < 2 && zVarIndex[i] >= 0; i++)
+      {
+        if(bank)
+          bank->Fill(zBankId, vars.V[zVarIndex[i]], w);
+        else
+          zHisto->Fill(vars.V[zVarIndex[i]], w);
+      }
+    }
 };
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 
@@ -92,105 +424,35 @@ class ZVarHisto
 //   TLorentzVector* tbar: antitop quark momentum
 //   TLorentzVector* vecLepM: leptoni momentum (if needed, can be omitted)
 //   TLorentzVector* vecLepP: lepton+ momentum (if needed, can be omitted)
+//   ZHistoBank* bank: histogram bank with booked histograms (if omitted, 
+//                     histograms are filled directly)
+// All fills of one output must use the same weight (the output weight): 
+// in the parallel event loop the histogram bank shards are filled with 
+// unit weight and scaled when merged (see ZHistoBank::MergeShards() in 
+// histoBank.h), shards reject any other weight.
 //
-void FillHistos(std::vector<ZVarHisto>& VecVarHisto, double w, TLorentzVector* t, TLorentzVector* tbar, TLorentzVector* vecLepM = NULL, TLorentzVector* vecLepP = NULL)
+void FillHistos(std::vector<ZVarHisto>& VecVarHisto, double w, TLorentzVector* t, TLorentzVector* tbar, TLorentzVector* vecLepM = NULL, TLorentzVector* vecLepP = NULL, 
+                ZHistoBank* bank = NULL)
 {
-  // momentum of ttbar pair
-  TLorentzVector ttbar = *t + *tbar;
+  ZPROFILE_SCOPE(kProfFillHistos);
+  // all variables are calculated once (see ZEventVars above)
+  ZEventVars vars;
+  vars.Set(t, tbar, vecLepM, vecLepP);
   // loop over provided histograms to be filled
   for(int h = 0; h < VecVarHisto.size(); h++)
-  {
-    // check if there is extra cut before filling histograms
-    TString cutVar = VecVarHisto[h].CutV();
-    double min = VecVarHisto[h].CutMin();
-    double max = VecVarHisto[h].CutMax();
-    if(cutVar != "")
-    {
-      // top rapidity, absolute value
-      if(cutVar == "ayt")
-      {
-        if(TMath::Abs(t->Rapidity()) < min || TMath::Abs(t->Rapidity()) > max)
-          continue;
-      }
-      // ttbar invariant mass
-      else if(cutVar == "mtt")
-      {
-        if(ttbar.M() < min || ttbar.M() > max)
-          continue;
-      }
-      // unknown (not implemented) cut variable
-      // (you can implement more cut variables here if needed)
-      else
-      {
-        printf("Error: unknown cut variable %s\n", cutVar.Data());
-        exit(1);
-        //continue;
-      }
-    }
-    // retrieve variable name
-    TString var = VecVarHisto[h].V();
-    // retrieve histogram
-    TH1* histo = VecVarHisto[h].H();
-    // now fill histograms depending on the variable:
-    // top pT
-    if(var == "ptt") 
-      histo->Fill(t->Pt(), w);
-    // antitop pT
-    else if(var == "ptat") 
-      histo->Fill(tbar->Pt(), w);
-    // top pT, antitop pT (two entries per one event)
-    else if(var == "pttat") 
-    {
-      histo->Fill(t->Pt(), w);
-      histo->Fill(tbar->Pt(), w);
-    }
-    // ttbar pT
-    else if(var == "pttt") 
-      histo->Fill(ttbar.Pt(), w);
-    // top rapidity
-    else if(var == "yt") 
-      histo->Fill(t->Rapidity(), w);
-    // top rapidity, absolute value
-    else if(var == "ayt")
-      histo->Fill(TMath::Abs(t->Rapidity()), w);
-    // antitop pT
-    else if(var == "yat") 
-      histo->Fill(tbar->Rapidity(), w);
-    // top rapidity, antitop rapidity (two entries per one event)
-    else if(var == "ytat") 
-    {
-      histo->Fill(t->Rapidity(), w);
-      histo->Fill(tbar->Rapidity(), w);
-    }
-    // ttbar rapidity
-    else if(var == "ytt") 
-      histo->Fill(ttbar.Rapidity(), w);
-    // ttbar rapidity, absolue value
-    else if(var == "aytt")
-      histo->Fill(TMath::Abs(ttbar.Rapidity()), w);
-    // ttbar invariant mass
-    else if(var == "mtt") 
-      histo->Fill(ttbar.M(), w);
-    // delta phi between top and antitop
-    else if(var == "dphitt")
-      histo->Fill(TMath::Abs(t->DeltaPhi(*tbar)), w);
-    else if(var == "detatt")
-      histo->Fill(TMath::Abs(t->PseudoRapidity() - tbar->PseudoRapidity()), w);
-    // lepton pT
-    else if(var == "ptl") 
-    {
-      histo->Fill(vecLepM->Pt(), w);
-      histo->Fill(vecLepP->Pt(), w);
-    }
-    // unknown (not implemented) variable
-    // (you can implement more variables here if needed)
-    else
-    {
-      //printf("Error: unknown variable %s\n", var.Data());
-      //exit(1);
-      continue;
-    } // end variable for histo
-  } // end loop over histos
+    VecVarHisto[h].Fill(vars, w, bank);
+}
+
+// same as above for reconstructed events (see fourVector.h): four vectors 
+// are converted to TLorentzVector only here, for histogram filling
+void FillHistos(std::vector<ZVarHisto>& VecVarHisto, double w, const ZFourVector& t, const ZFourVector& tbar, 
+                const ZFourVector& vecLepM, const ZFourVector& vecLepP, ZHistoBank* bank = NULL)
+{
+  TLorentzVector tVec = t.LorentzVector();
+  TLorentzVector tbarVec = tbar.LorentzVector();
+  TLorentzVector lepMVec = vecLepM.LorentzVector();
+  TLorentzVector lepPVec = vecLepP.LorentzVector();
+  FillHistos(VecVarHisto, w, &tVec, &tbarVec, &lepMVec, &lepPVec, bank);
 }
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 
@@ -200,11 +462,29 @@ void FillHistos(std::vector<ZVarHisto>& VecVarHisto, double w, TLorentzVector* t
 //
 // Store bunch of histogram (argument std::vector<ZVarHisto>& VecVarHisto)
 // (stores a copy of histogram)
+// 2D histograms are stored as 1D histograms, one per y bin (bin contents and 
+// errors including x underflow and overflow), named according to the slice 
+// name format: these are the same histograms as filled with extra cuts.
+// If histogram bank is provided, histograms are copied from it first.
 //
-void StoreHistos(std::vector<ZVarHisto>& VecVarHisto)
+void StoreHistos(std::vector<ZVarHisto>& VecVarHisto, const ZHistoBank* bank = NULL)
 {
   for(int h = 0; h < VecVarHisto.size(); h++)
   {
+    if(bank)
+      bank->Store(VecVarHisto[h].BankId(), VecVarHisto[h].H());
+    TH2D* histo2D = VecVarHisto[h].H2D();
+    if(histo2D)
+    {
+      for(int j = 1; j <= histo2D->GetNbinsY(); j++)
+      {
+        TH1D* slice = histo2D->ProjectionX(TString::Format(VecVarHisto[h].SliceName().Data(), j), j, j, "e");
+        slice->SetTitle(histo2D->GetTitle());
+        slice->Write();
+        delete slice;
+      }
+      continue;
+    }
     TH1* histo = VecVarHisto[h].H();
     TString name = histo->GetName();
     TString title = histo->GetTitle();
@@ -214,6 +494,61 @@ void StoreHistos(std::vector<ZVarHisto>& VecVarHisto)
 }
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>> Output of eventreco routine (one set of histograms)  >>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Several outputs (e.g. all decay channels, or reco and gen levels of 
+// signal MC) can be filled from the same input sample in one event loop, 
+// see ZEventRecoInput::AddOutput() below.
+//
+class ZEventRecoOutput
+{
+  public:
+    TString Name; // name pattern (to be used in output histograms)
+    std::vector<ZVarHisto> VecVarHisto; // container with needed histograms
+    ZHistoBank Bank; // histogram bank filled in the event loop (see histoBank.h)
+    int Channel; // 1 ee, 2 mumu, 3 emu
+    int Type; // 1 data, 2 MC signal, 3 MC ttbar other, 4 MC background
+    bool Gen; // if true, the histogram is filled at true level
+    double Weight; // weight for histogram filling (the weight of the input, set in eventreco)
+    // event counters (filled in eventreco)
+    long NSel; // number of selected events
+    long NReco; // number of events with successfull kinematic reconstruction
+    int NGen; // number of events at generator level
+    
+    // constructor
+    ZEventRecoOutput()
+    {
+      // set default values
+      Channel = 0;
+      Type = 0;
+      Gen = false;
+      Weight = 1.0;
+      NSel = NReco = NGen = 0;
+    }
+
+    // shard of this output for one thread of the event loop: the same settings 
+    // and booked histogram bank (empty), unit weight, zero counters; own 
+    // histograms are not copied (shards fill the bank only)
+    ZEventRecoOutput MakeShard() const
+    {
+      ZEventRecoOutput shard;
+      shard.Name = Name;
+      shard.Channel = Channel;
+      shard.Type = Type;
+      shard.Gen = Gen;
+      shard.VecVarHisto.reserve(VecVarHisto.size());
+      for(int h = 0; h < VecVarHisto.size(); h++)
+        shard.VecVarHisto.push_back(ZVarHisto(VecVarHisto[h], false));
+      shard.Bank = Bank;
+      shard.Bank.Reset();
+      shard.Bank.SetShard(true);
+      return shard;
+    }
+};
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 // >>>>>> Input parameters for eventreco routine (see below)  >>>>>>>>>>
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
@@ -228,6 +563,26 @@ class ZEventRecoInput
     std::vector<TString> VecInFile; // container with input files
     double Weight; // weight for histogram filling
     long MaxNEvents; // maximum number of processed events
+    int NThreads; // number of threads for the event loop (1 for serial processing)
+    // input reading settings (see ConfigureCache() below)
+    Long64_t CacheSize; // TTreeCache size in bytes (0 to switch the cache off, -1 for ROOT default)
+    int CacheLearnEntries; // number of entries in the cache learning phase (0 for no learning phase)
+    bool CacheReadSet; // if true, branches to be read (read-set) are registered in the cache explicitly
+    bool Prefetch; // if true, the next input file is prefetched (read ahead by the system) while the current one is processed
+    bool UseIndex; // if true, the chain is built from cached per-directory index of input files (see chainIndex.h)
+    int KinRecoBlock; // if > 0, kinematic reconstruction is done in batches of this number of selected events (see kinRecoBatch.h), 
+                      // otherwise event by event (results are identical)
+    bool KinRecoCache; // if true, results of event selection and kinematic reconstruction are stored in gCacheDir (see settings.h) 
+                       // and used instead of the input ntuples, if available (see kinRecoCache.h)
+    bool UsePreselIndex; // if true, only candidate events are read, using per file preselection index (see preselIndex.h), 
+                         // needs UseIndex
+    bool UseSkim; // if true, events which pass primary vertex, trigger and dilepton selection are stored in a skim in gSkimDir 
+                  // (see settings.h), which is read instead of the input ntuples, if available (see skim.h)
+    int CutFlow; // reco level cut flow (see cutFlow.h): 0 off, 1 cuts are accounted (default order), 
+                 // 2 cuts are accounted and reordered to minimise time per event (selected events are identical)
+    // container with outputs to be filled in one event loop (see AddOutput() below);
+    // if empty, one output is made from Name, VecVarHisto, Channel, Type and Gen above
+    std::vector<ZEventRecoOutput> VecOutput;
     
     // contstructor
     ZEventRecoInput()
@@ -236,6 +591,17 @@ class ZEventRecoInput
       Weight = 1.0;
       MaxNEvents = 100e10;
       Gen = false;
+      NThreads = 1;
+      CacheSize = -1;
+      CacheLearnEntries = 100;
+      CacheReadSet = true;
+      Prefetch = false;
+      UseIndex = true;
+      KinRecoBlock = 0;
+      KinRecoCache = false;
+      UsePreselIndex = false;
+      UseSkim = false;
+      CutFlow = 0;
     }
     
     // add one more input file (str) to the chain
@@ -249,227 +615,1284 @@ class ZEventRecoInput
     {
       VecInFile.clear();
     }
+
+    // add one more output: histograms (vecVarHisto, copied, which is cheap, see ZVarHisto) 
+    // for given decay channel, type and level (gen = true for generator level) will be filled with 
+    // Weight (set in eventreco, so Weight can be set before or after adding outputs) in the same 
+    // event loop as all other outputs
+    void AddOutput(const TString& name, const int channel, const int type, const bool gen, const std::vector<ZVarHisto>& vecVarHisto)
+    {
+      ZEventRecoOutput out;
+      out.Name = name;
+      out.Channel = channel;
+      out.Type = type;
+      out.Gen = gen;
+      out.VecVarHisto = vecVarHisto;
+      VecOutput.push_back(out);
+    }
 };
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-// >>>>>>>>> Basic routine for ttbar event reconstruction >>>>>>>>>>>>>>
+// >>>>>> Result of reco level event reconstruction (see below) >>>>>>>>
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-void eventreco(ZEventRecoInput in)
-{ 
-  printf("****** EVENTRECO ******\n");
-  printf("input sample: %s\n", in.Name.Data());
-  printf("type: %d   channel: %d\n", in.Type, in.Channel);
-  
+struct ZEventRecoResult
+{
+  // status: 0 event not selected, 1 selected (kinreco failed), 2 selected with successfull kinreco
+  int Status;
+  // true if the event passed primary vertex, trigger and dilepton selection (not MET, see skim.h)
+  bool Presel;
+  // selected lepton- and lepton+
+  ZFourVector LepM, LepP;
+  // reconstructed top and antitop (if Status == 2)
+  ZFourVector T, Tbar;
+  // index of the event in ZKinRecoBatch, if kinreco is postponed (see RecoEvent() below), otherwise -1
+  int BatchIndex;
+};
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>> Read-sets >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Branches read by event reconstruction steps (see tree.h, and selection.h 
+// for primary vertex, trigger, leptons and jets): only the branches needed by the outputs are activated 
+// in the input tree (see ReadSetOutput() and MakeInputTree() below).
+//
+// run and event numbers
+const ZReadSet kReadSetEvent = ZBranchBit(kBrEvRunNumber) | ZBranchBit(kBrEvEventNumber);
+// missing transverse energy
+const ZReadSet kReadSetMET = ZBranchBit(kBrMetPx) | ZBranchBit(kBrMetPy);
+// MC event type
+const ZReadSet kReadSetMCType = ZBranchBit(kBrMcEventType);
+// generator level top and antitop
+const ZReadSet kReadSetGen = ZBranchBit(kBrMcT) | ZBranchBit(kBrMcTbar);
+
+// branches needed for reco level in given channel (1 ee, 2 mumu, 3 emu)
+ZReadSet ReadSetReco(const int channel)
+{
+  ZReadSet readSet = kReadSetPV | kReadSetTrig | kReadSetMET | kReadSetJets;
+  if(channel == 1 || channel == 3)
+    readSet |= kReadSetEl;
+  if(channel == 2 || channel == 3)
+    readSet |= kReadSetMu;
+  return readSet;
+}
+
+// branches needed to fill given output
+ZReadSet ReadSetOutput(const ZEventRecoOutput& out)
+{
+  ZReadSet readSet = 0;
+  if(out.Type == 2 || out.Type == 3)
+    readSet |= kReadSetMCType;
+  if(out.Gen)
+    readSet |= kReadSetGen;
+  else
+    readSet |= ReadSetReco(out.Channel);
+  return readSet;
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>> Reco level cuts >>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Applies one cut (see ERecoCut in cutFlow.h) to the current event: the 
+// needed branches are read first (only when they are needed, see ZTree::Load()).
+// The cuts are independent, so they can be applied in any order.
+// Arguments:
+//   const int cut: cut to be applied
+//   ZTree* preselTree, const int channel, ZEventRecoResult& res: as in RecoEvent() below 
+//                                                            (leptons are stored in res)
+//   const double bTagDiscr: b-tagging discriminator threshold
+//   ZJet* vecJets, int& nJets: selected jets (output of the kCutJets cut)
+// Returns true if the event passes the cut.
+//
+bool ApplyRecoCut(const int cut, ZTree* preselTree, const int channel, ZEventRecoResult& res, const double bTagDiscr, ZJet* vecJets, int& nJets)
+{
+  if(cut == kCutPV)
+  {
+    // primary vertex selection (see selection.h)
+    preselTree->Load(kReadSetPV);
+    return SelectPV(preselTree);
+  }
+  if(cut == kCutTrig)
+  {
+    // trigger (accept the event if at least one needed trigger bit is fired, see TriggerMask() in selection.h) 
+    preselTree->Load(kReadSetTrig);
+    return SelectTrigger(preselTree, channel);
+  }
+  if(cut == kCutMET)
+  {
+    // additional requirement on the missing transverse energy (ee and mumu only)
+    if(!RecoCutApplies(cut, channel))
+      return true;
+    preselTree->Load(kReadSetMET);
+    ZTREE_REQUIRE(preselTree, kReadSetMET, "ApplyRecoCut");
+    double met = TMath::Sqrt(TMath::Power(preselTree->metPx, 2.0) + TMath::Power(preselTree->metPy, 2.0));
+    return (met > 40.0);
+  }
+  if(cut == kCutDilep)
+  {
+    // call dileption selection routine (see selection.h for description), 
+    // read only leptons needed in this channel
+    double maxPtDiLep = -1.0; // initialise with a negative value to determine whether a dilepton pair is found in the event
+    if(channel == 1)
+    {
+      preselTree->Load(kReadSetEl);
+      SelectDilepEE(preselTree, res.LepM, res.LepP, maxPtDiLep);
+    }
+    else if(channel == 2)
+    {
+      preselTree->Load(kReadSetMu);
+      SelectDilepMuMu(preselTree, res.LepM, res.LepP, maxPtDiLep);
+    }
+    else
+    {
+      preselTree->Load(kReadSetEl | kReadSetMu);
+      SelectDilepEMu(preselTree, res.LepM, res.LepP, maxPtDiLep);
+    }
+    return (maxPtDiLep >= 0.0);
+  }
+  if(cut == kCutBTagAny)
+  {
+    // fast b-tagging check, before jets are built (see selection.h)
+    preselTree->Load(kReadSetJets);
+    return AnyBTagJet(preselTree, bTagDiscr);
+  }
+  if(cut == kCutJets)
+  {
+    // all jets are stored for kinematic reconstruction;
+    // require at least two jets, at least one of them b-tagged
+    preselTree->Load(kReadSetJets);
+    bool oneBTagJet = false;
+    nJets = SelectJets(preselTree, bTagDiscr, vecJets, oneBTagJet);
+    return (nJets >= 2 && oneBTagJet);
+  }
+  printf("Error in ApplyRecoCut(): unknown cut %d\n", cut);
+  exit(1);
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>> Reco level event reconstruction for one channel >>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Arguments:
+//   ZTree* preselTree: input tree (see tree.h), LoadEntry() or GetEntry() should be done already 
+//                      (the branches are read in stages, only when they are needed, see ZTree::Load())
+//   const int channel: decay channel (1 ee, 2 mumu, 3 emu)
+//   ZEventRecoResult& res: result (output, see above)
+//   TH1D* hInacc, hAmbig: histograms for kinematic reconstruction debugging (see kinReco.h)
+//   ZKinRecoBatch* batch: if provided, kinematic reconstruction of selected event is postponed: 
+//                         the event is added to the batch (see kinRecoBatch.h) and res.Status is 1
+//   ZCutFlow* cutFlow: if provided, the cuts are applied in its order and accounted in it (see cutFlow.h), 
+//                      otherwise in the default order
+// Returns res.Status
+//
+int RecoEvent(ZTree* preselTree, const int channel, ZEventRecoResult& res, TH1D* hInacc = NULL, TH1D* hAmbig = NULL, 
+              ZKinRecoBatch* batch = NULL, ZCutFlow* cutFlow = NULL)
+{
   // steering
   // b-tagging discriminator for Combined Secondary Vertex Loose 
   // (consult https://twiki.cern.ch/twiki/bin/view/CMSPublic/BtagRecommendation2011OpenData)
   const double bTagDiscrL = 0.244;
-  // directory for output ROOT files with histograms
-  TString outDir = gHistDir; 
 
-  // this flag determines whether generator level information is available
-  // (should be available for signal MC)
-  bool flagMC = (in.Type == 2 || in.Type == 3);
-  
-  // output file
-  TFile* fout = TFile::Open(TString::Format("%s/%s-c%d.root", outDir.Data(), in.Name.Data(), in.Channel), "recreate");
+  res.Status = 0;
+  res.Presel = false;
+  res.BatchIndex = -1;
+  ZFourVector& vecLepM = res.LepM;
+  ZFourVector& vecLepP = res.LepP;
+  // (fixed size array: no memory allocation per event, see selection.h)
+  ZJet vecJets[ZTree::maxNjet];
+  int nJets = 0;
+  // apply cuts: primary vertex, trigger and dilepton pair (preselection), 
+  // then MET (ee and mumu) and jets; skip the event as soon as it fails one cut
+  for(int i = 0; i < kNRecoCuts; i++)
+  {
+    // preselection cuts come first in any order (see cutFlow.h)
+    if(i == kNPreselCuts)
+      res.Presel = true;
+    const int cut = cutFlow ? cutFlow->Order(i) : i;
+    if(!RecoCutApplies(cut, channel))
+      continue;
+    bool pass = false;
+    if(cutFlow)
+    {
+      const double t0 = ProfileClock(CLOCK_MONOTONIC);
+      pass = ApplyRecoCut(cut, preselTree, channel, res, bTagDiscrL, vecJets, nJets);
+      cutFlow->Account(cut, pass, ProfileClock(CLOCK_MONOTONIC) - t0);
+    }
+    else
+      pass = ApplyRecoCut(cut, preselTree, channel, res, bTagDiscrL, vecJets, nJets);
+    if(!pass)
+    {
+      if(cutFlow)
+        cutFlow->EndEvent();
+      return res.Status;
+    }
+  }
+  if(cutFlow)
+    cutFlow->EndEvent();
+  // event selection done
+  res.Status = 1;
+  // MET is needed for kinematic reconstruction (in all channels)
+  preselTree->Load(kReadSetMET);
+  ZTREE_REQUIRE(preselTree, kReadSetJets | kReadSetMET, "RecoEvent");
   
-  // input tree
+  // kinematic reconstruction in batch (later, see EventLoop() below)
+  if(batch)
+  {
+    res.BatchIndex = batch->AddEvent(vecLepM, vecLepP, vecJets, nJets, preselTree->metPx, preselTree->metPy);
+    return res.Status;
+  }
+  // now run kinematic reconstruction to restore the top and antitop momenta
+  // call main routine, see kinReco.h for description
+  int status = 0;
+  {
+    ZPROFILE_SCOPE(kProfKinReco);
+    status = KinRecoDilepton(vecLepM, vecLepP, vecJets, nJets, preselTree->metPx, preselTree->metPy, res.T, res.Tbar, hInacc, hAmbig);
+  }
+  // returned status is 1 for successfull kinreco, 0 otherwise
+  // t, tbar are vectors with single "best" solution (if kinreco was successfull)
+  //printf("STATUS: %d\n", status);
+  if(status > 0) // successfull kinreco
+  {
+    // print the top and antitop momenta, if needed
+    //printf("top:      (%8.3f  %8.3f  %8.3f  %8.3f)\n", res.T.X(), res.T.Y(), res.T.Z(), res.T.M());
+    //printf("antitop:  (%8.3f  %8.3f  %8.3f  %8.3f)\n", res.Tbar.X(), res.Tbar.Y(), res.Tbar.Z(), res.Tbar.M());
+    res.Status = 2;
+  }
+  return res.Status;
+}
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>> Configure TTreeCache >>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// TTreeCache reads baskets of many branches in few large read calls, 
+// which matters for spinning disks and network file systems.
+// Arguments:
+//   TChain* chain: input chain
+//   const ZEventRecoInput& in: cache settings (CacheSize, CacheLearnEntries, CacheReadSet)
+//   const ZReadSet readSet: active branches (see tree.h)
+//
+void ConfigureCache(TChain* chain, const ZEventRecoInput& in, const ZReadSet readSet)
+{
+  // ROOT default
+  if(in.CacheSize < 0)
+    return;
+  chain->SetCacheSize(in.CacheSize);
+  if(in.CacheSize == 0)
+    return;
+  if(in.CacheLearnEntries > 0)
+    chain->SetCacheLearnEntries(in.CacheLearnEntries);
+  if(in.CacheReadSet)
+  {
+    // all active branches will be read (at least partially, see ZTree::Load()), 
+    // so the learning phase is not needed unless requested explicitly
+    for(int br = 0; br < kBrNBranches; br++)
+      if(readSet & ZBranchBit(br))
+        chain->AddBranchToCache(ZTree::BranchName(br), true);
+    if(in.CacheLearnEntries <= 0)
+      chain->StopCacheLearningPhase();
+  }
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>> Input tree for eventreco routine >>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Creates TChain with all input files and ZTree (see tree.h) attached to it.
+// Arguments:
+//   const ZEventRecoInput& in: input settings (see above)
+//   const bool flagMC: true if generator level information is available
+//   const ZReadSet readSet: branches to be read (see above), all other branches are not read
+//
+ZTree* MakeInputTree(const ZEventRecoInput& in, const bool flagMC, const ZReadSet readSet, const ZChainIndex* index = NULL)
+{
   TChain* chain = new TChain("tree");
-  for(int f = 0; f < in.VecInFile.size(); f++)
-    chain->Add(in.VecInFile[f]);
+  if(index)
+    index->AddToChain(chain);
+  else
+    for(int f = 0; f < in.VecInFile.size(); f++)
+      chain->Add(in.VecInFile[f]);
   ZTree* preselTree = new ZTree(flagMC);
   preselTree->Init(chain);
+  preselTree->SetReadSet(readSet);
+  ConfigureCache(chain, in, preselTree->ReadSet());
+  return preselTree;
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>> Input reading statistics >>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Collected file by file in the event loop and printed at the end of eventreco
+// (numbers of read calls and read bytes are taken from TFile global counters).
+//
+struct ZReadStats
+{
+  // constructor
+  ZReadStats(): NFiles(0), NEntries(0), SumHitRate(0.0) {;}
+  // number of processed input files
+  int NFiles;
+  // number of processed entries
+  long NEntries;
+  // sum over files of TTreeCache hit rate (fraction of requested baskets found in the cache), 
+  // weighted by the number of processed entries
+  double SumHitRate;
 
-  // process generator level, if needed
-  if(in.Gen)
+  // collect cache statistics of the current file of provided chain, 
+  // nEntries entries of this file were processed
+  void AddFile(TTree* chain, const long nEntries)
   {
-    chain->SetBranchStatus("*", 0);
-    chain->SetBranchStatus("mcEventType", 1);
-    chain->SetBranchStatus("mcT", 1);
-    chain->SetBranchStatus("mcTbar", 1);
+    NFiles++;
+    NEntries += nEntries;
+    TFile* file = chain->GetCurrentFile();
+    if(!file)
+      return;
+    TTreeCache* cache = (TTreeCache*)file->GetCacheRead(chain->GetTree());
+    if(cache)
+      SumHitRate += cache->GetEfficiencyRel() * nEntries;
   }
-    
-  // event counters
-  long nSel = 0;
-  long nReco = 0;
-  int nGen = 0;
-  
-  // histograms for kinematic reconstruction debugging
-  // (not needed in physics analysis, not stored)
-  TH1D* hInacc = new TH1D("hInacc", "KinReco inaccuracy", 1000, 0.0, 100.0);
-  TH1D* hAmbig = new TH1D("hAmbig", "KinReco ambiguity", 100, 0.0, 100.0);
 
-  // determine number of events
-  long nEvents = chain->GetEntries();
-  //limit it if exceeds the specified maximum number
-  if(nEvents > in.MaxNEvents)
-    nEvents = in.MaxNEvents;
-  printf("nEvents: %ld\n", nEvents);
-  // event loop
-  for(int e = 0; e < nEvents; e++)
-  {
-    chain->GetEntry(e);
-    if(flagMC)
-    {
-      // skip background events for MC signal
-      if(in.Type == 2 && preselTree->mcEventType != in.Channel) continue;
-      // skip signal events for MC 'ttbar other' (background)
-      if(in.Type == 3 && preselTree->mcEventType == in.Channel) continue;
-    }
-    // process generator level if needed
-    if(in.Gen)
-    {
-      // prepare four vectors for top and antitop
-      TLorentzVector t, tbar;
-      t.SetXYZM(preselTree->mcT[0], preselTree->mcT[1], preselTree->mcT[2], preselTree->mcT[3]);
-      tbar.SetXYZM(preselTree->mcTbar[0], preselTree->mcTbar[1], preselTree->mcTbar[2], preselTree->mcTbar[3]);
-      // fill histos
-      double w = in.Weight;
-      FillHistos(in.VecVarHisto, w, &t, &tbar);
-      nGen++;
+  // add statistics from other event loop (thread)
+  void Add(const ZReadStats& stats)
+  {
+    NFiles += stats.NFiles;
+    NEntries += stats.NEntries;
+    SumHitRate += stats.SumHitRate;
+  }
+
+  // average cache hit rate
+  double HitRate() const { return (NEntries > 0) ? (SumHitRate / NEntries) : 0.0; }
+};
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>> Prefetch input file >>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Asks the system to read provided (local or network mounted) file into 
+// the page cache in background, so that opening and reading it later 
+// does not wait for the disk. Returns immediately. Files accessed via 
+// ROOT protocols (e.g. root://) are skipped.
+//
+void PrefetchFile(const char* name)
+{
+  if(TString(name).Contains("://"))
+    return;
+  int fd = open(name, O_RDONLY);
+  if(fd < 0)
+    return;
+  posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+  close(fd);
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>> Postponed kinreco outputs >>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// With batched kinematic reconstruction (see EventLoop() below), histograms 
+// of selected events are filled after the batch is solved: for each selected 
+// event and output, the output and selected leptons are queued.
+//
+struct ZPendingReco
+{
+  int Output; // output index
+  int BatchIndex; // event index in ZKinRecoBatch
+  ZFourVector LepM, LepP; // selected leptons
+};
+
+// solve batch and fill outputs of queued events (in the same order as they were queued), 
+// then clear the batch and the queue; if cache is provided, its records of the batch 
+// events are completed (see ZKinRecoCache::BatchRecord in kinRecoCache.h)
+void FlushKinRecoBatch(ZKinRecoBatch& batch, std::vector<ZPendingReco>& vecPending, std::vector<ZEventRecoOutput>& vecOut, 
+                       TH1D* hInacc = NULL, TH1D* hAmbig = NULL, ZKinRecoCache* cache = NULL)
+{
+  {
+    ZPROFILE_SCOPE(kProfKinReco);
+    batch.Solve(hInacc, hAmbig);
+  }
+  if(cache)
+  {
+    for(int ev = 0; ev < cache->BatchRecord.size(); ev++)
+    {
+      if(!batch.Status(ev))
+        continue;
+      ZKinRecoCacheReco& rec = cache->Reco[cache->BatchRecord[ev]];
+      rec.Status = 2;
+      rec.T = batch.T(ev);
+      rec.Tbar = batch.Tbar(ev);
+    }
+    cache->BatchRecord.clear();
+  }
+  for(int p = 0; p < vecPending.size(); p++)
+  {
+    ZPendingReco& pending = vecPending[p];
+    if(!batch.Status(pending.BatchIndex))
+      continue;
+    // successfull kinreco
+    ZEventRecoOutput& out = vecOut[pending.Output];
+    out.NReco++;
+    // fill histograms
+    FillHistos(out.VecVarHisto, out.Weight, batch.T(pending.BatchIndex), batch.Tbar(pending.BatchIndex), pending.LepM, pending.LepP, &out.Bank);
+  }
+  batch.Clear();
+  vecPending.clear();
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>> Kinreco result cache of one event >>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Adds results of the current event to the cache (see kinRecoCache.h): 
+// reco level is done for all channels in the cache content, independently 
+// of MC event type, so that the cache can be used for any output, 
+// the results are stored in res and done (see EventLoop() below).
+//
+void RecordKinRecoCache(ZTree* preselTree, ZKinRecoCache& cache, ZEventRecoResult* res, bool* done, 
+                        TH1D* hInacc = NULL, TH1D* hAmbig = NULL, ZKinRecoBatch* batch = NULL, ZCutFlow* cutFlow = NULL)
+{
+  cache.NEvents++;
+  preselTree->Load(kReadSetEvent);
+  ZTREE_REQUIRE(preselTree, kReadSetEvent, "RecordKinRecoCache");
+  int mcEventType = 0;
+  if(cache.Content & kKinRecoCacheMCType)
+  {
+    preselTree->Load(kReadSetMCType);
+    ZTREE_REQUIRE(preselTree, kReadSetMCType, "RecordKinRecoCache");
+    mcEventType = preselTree->mcEventType;
+    if(mcEventType >= 0 && mcEventType < 4)
+      cache.NEventsType[mcEventType]++;
+  }
+  // reco level
+  for(int ch = 1; ch <= 3; ch++)
+  {
+    if(!(cache.Content & KinRecoCacheChannelBit(ch)))
       continue;
+    RecoEvent(preselTree, ch, res[ch], hInacc, hAmbig, batch, cutFlow ? &cutFlow[ch] : NULL);
+    done[ch] = true;
+    if(res[ch].Status < 1)
+      continue;
+    ZKinRecoCacheReco rec;
+    rec.Run = preselTree->evRunNumber;
+    rec.Event = preselTree->evEventNumber;
+    rec.McEventType = mcEventType;
+    rec.Channel = ch;
+    rec.Status = res[ch].Status;
+    rec.LepM = res[ch].LepM;
+    rec.LepP = res[ch].LepP;
+    rec.T = res[ch].T;
+    rec.Tbar = res[ch].Tbar;
+    // postponed kinreco: the record is completed when the batch is solved 
+    // (batch events are added in the same order)
+    if(res[ch].BatchIndex >= 0)
+      cache.BatchRecord.push_back(cache.Reco.size());
+    cache.Reco.push_back(rec);
+  }
+  // generator level (MC signal)
+  if((cache.Content & kKinRecoCacheGen) && mcEventType >= 1 && mcEventType <= 3)
+  {
+    preselTree->Load(kReadSetGen);
+    ZTREE_REQUIRE(preselTree, kReadSetGen, "RecordKinRecoCache");
+    ZKinRecoCacheGen gen;
+    gen.Run = preselTree->evRunNumber;
+    gen.Event = preselTree->evEventNumber;
+    gen.McEventType = mcEventType;
+    gen.T.SetXYZM(preselTree->mcT[0], preselTree->mcT[1], preselTree->mcT[2], preselTree->mcT[3]);
+    gen.Tbar.SetXYZM(preselTree->mcTbar[0], preselTree->mcTbar[1], preselTree->mcTbar[2], preselTree->mcTbar[3]);
+    cache.Gen.push_back(gen);
+  }
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>> Skim of one event >>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Counts the current event (entry) and writes it to the skim (see skim.h) 
+// if it passes primary vertex, trigger and dilepton selection (the MET cut 
+// is not applied) in any channel of the skim content (independently of MC event type), or if it is an 
+// MC signal event needed at generator level; reco level results are stored 
+// in res and done (see EventLoop() below).
+//
+void SkimEvent(ZTree* preselTree, ZSkimWriter& skim, const long entry, ZEventRecoResult* res, bool* done, 
+               TH1D* hInacc = NULL, TH1D* hAmbig = NULL, ZKinRecoBatch* batch = NULL, ZCutFlow* cutFlow = NULL)
+{
+  skim.NEvents++;
+  int mcEventType = 0;
+  if(skim.Content() & kKinRecoCacheMCType)
+  {
+    preselTree->Load(kReadSetMCType);
+    ZTREE_REQUIRE(preselTree, kReadSetMCType, "SkimEvent");
+    mcEventType = preselTree->mcEventType;
+    if(mcEventType >= 0 && mcEventType < 4)
+      skim.NEventsType[mcEventType]++;
+  }
+  // generator level (MC signal)
+  bool keep = (skim.Content() & kKinRecoCacheGen) && mcEventType >= 1 && mcEventType <= 3;
+  // reco level
+  for(int ch = 1; ch <= 3; ch++)
+  {
+    if(!(skim.Content() & KinRecoCacheChannelBit(ch)))
+      continue;
+    if(!done[ch])
+    {
+      RecoEvent(preselTree, ch, res[ch], hInacc, hAmbig, batch, cutFlow ? &cutFlow[ch] : NULL);
+      done[ch] = true;
     }
-    if(in.Type > 1)
-      nGen++;
-    
-    // process reco level if needed
-    //
-    // primary vertex selection
-    if(preselTree->Npv < 1 || preselTree->pvNDOF < 4 || preselTree->pvRho > 2.0 || TMath::Abs(preselTree->pvZ) > 24.0)
+    if(res[ch].Presel)
+      keep = true;
+  }
+  if(keep)
+    skim.Fill(preselTree, entry);
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>> Count skipped event >>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Event which is not a candidate for any output (see ZPreselIndex in 
+// preselIndex.h) is not read: it is counted for outputs at generator 
+// level and for the kinreco result cache as in EventLoop() below, 
+// using its MC event type from the preselection index.
+//
+void CountSkippedEvent(std::vector<ZEventRecoOutput>& vecOut, const int mcEventType, ZKinRecoCache* cache = NULL)
+{
+  for(int o = 0; o < vecOut.size(); o++)
+  {
+    ZEventRecoOutput& out = vecOut[o];
+    if(out.Gen || out.Type <= 1)
       continue;
-    // primary dataset name
-    TString inFile = chain->GetCurrentFile()->GetName();
-    // select dilepton pair
-    TLorentzVector vecLepM, vecLepP;
-    double maxPtDiLep = -1.0; // initialise with a negative value to determine later on whether a dilepton pair is found in the event
-    bool trig = false;
-    // *****************************************
-    // ***************** emu *******************
-    // *****************************************
-    if(in.Channel == 3)
-    {
-      // trigger: 4th to 5th bits
-      // (accept the event if at least one needed trigger bit is fired) 
-      for(int bit = 4; bit < 6; bit++)
-        if((preselTree->Triggers >> bit) & 1)
-        {
-          trig = true;
-          break;
-        }
-      // call dileption selection routine (see selection.h for description)
-      if(trig)
-        SelectDilepEMu(preselTree, vecLepM, vecLepP, maxPtDiLep);
-    }
-    // *****************************************
-    // ***************** ee ********************
-    // *****************************************
-    if(in.Channel == 1)
-    {
-      // trigger: 2nd to 3rd bits
-      for(int bit = 2; bit < 4; bit++)
-        if((preselTree->Triggers >> bit) & 1)
-        {
-          trig = true;
-          break;
-        }
-      double met = TMath::Sqrt(TMath::Power(preselTree->metPx, 2.0) + TMath::Power(preselTree->metPy, 2.0));
-      // additional requirement on the missing transverse energy
-      if(trig && met > 40.0)
-        SelectDilepEE(preselTree, vecLepM, vecLepP, maxPtDiLep);
-    }
-    // *****************************************
-    // **************** mumu *******************
-    // *****************************************
-    if(in.Channel == 2)
-    {
-      // trigger: 0th to 1st bits
-      for(int bit = 0; bit < 2; bit++)
-        if((preselTree->Triggers >> bit) & 1)
+    if(out.Type == 2 && mcEventType != out.Channel) continue;
+    if(out.Type == 3 && mcEventType == out.Channel) continue;
+    out.NGen++;
+  }
+  if(cache)
+  {
+    cache->NEvents++;
+    if(cache->Content & kKinRecoCacheMCType)
+      cache->NEventsType[mcEventType]++;
+  }
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>> Event loop routine >>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Processes events [first, last) of the input tree and fills all outputs.
+// Arguments:
+//   ZTree* preselTree: input tree (see MakeInputTree() above)
+//   std::vector<ZEventRecoOutput>& vecOut: outputs to be filled (histograms and event counters)
+//   const long first, last: range of processed events
+//   TH1D* hInacc, hAmbig: histograms for kinematic reconstruction debugging (see kinReco.h)
+//   ZReadStats* readStats: input reading statistics (output, if provided)
+//   const bool prefetch: if true, the next input file is prefetched (see PrefetchFile() above)
+//   const int kinRecoBlock: if > 0, selected events are queued and kinematic reconstruction is done 
+//                           in batches of this number of events (see kinRecoBatch.h)
+//   ZKinRecoCache* cache: if provided, results are added to it (see RecordKinRecoCache() above)
+//   ZSkimWriter* skim: if provided, preselected events are written to it (see SkimEvent() above)
+//   const ZPreselIndex* presel: if provided, only candidate events are read, all other events 
+//                               are only counted (see CountSkippedEvent() above); 
+//                               should not be used together with skim
+//   ZProfile* profile: stage profile of this event loop is added to it (if compiled with 
+//                      -DEVENTRECO_PROFILE, see profile.h)
+//   ZCutFlow* cutFlow: if provided (array with index 1 ee, 2 mumu, 3 emu), reco level cuts 
+//                      are accounted in it and applied in its order (see cutFlow.h)
+//
+void EventLoop(ZTree* preselTree, std::vector<ZEventRecoOutput>& vecOut, const long first, const long last, 
+  TH1D* hInacc = NULL, TH1D* hAmbig = NULL, ZReadStats* readStats = NULL, const bool prefetch = false, 
+  const int kinRecoBlock = 0, ZKinRecoCache* cache = NULL, ZSkimWriter* skim = NULL, const ZPreselIndex* presel = NULL, 
+  ZProfile* profile = NULL, ZCutFlow* cutFlow = NULL)
+{
+  gProfileThread.Reset();
+  // batched kinematic reconstruction and queue of outputs to be filled
+  ZKinRecoBatch batch;
+  std::vector<ZPendingReco> vecPending;
+  TChain* chain = (TChain*)preselTree->fChain;
+  // current input file: number, first processed event and end
+  int treeNumber = -1;
+  long treeFirst = first;
+  long treeEnd = first;
+  // reco level results for each channel (index 1 ee, 2 mumu, 3 emu), 
+  // evaluated at most once per event
+  ZEventRecoResult res[4];
+  bool done[4];
+  // candidate events for the preselection index: reco level channels and 
+  // MC event types needed at generator level (all for other than MC signal)
+  int channelMask = 0;
+  int genTypeMask = 0;
+  for(int o = 0; o < vecOut.size(); o++)
+  {
+    if(!vecOut[o].Gen)
+      channelMask |= 1 << (vecOut[o].Channel - 1);
+    else
+      genTypeMask |= (vecOut[o].Type == 2) ? (1 << vecOut[o].Channel) : 0xf;
+  }
+  // event loop
+  for(long e = first; e < last; e++)
+  {
+    // preselection index: go to the next candidate event, skipped events are only counted
+    if(presel)
+    {
+      const long next = presel->Next(e, last, channelMask, genTypeMask);
+      for(; e < next; e++)
+        CountSkippedEvent(vecOut, presel->McEventType(e), cache);
+      if(e >= last)
+        break;
+    }
+    // collect statistics of the current input file before switching to the next one
+    if(e >= treeEnd && treeNumber >= 0 && readStats)
+      readStats->AddFile(chain, e - treeFirst);
+    // branches are read later, only when they are needed (see ZTree::Load())
+    if(!preselTree->LoadEntry(e))
+    {
+      treeNumber = -1;
+      break;
+    }
+    if(e >= treeEnd)
+    {
+      // new input file
+      treeNumber = chain->GetTreeNumber();
+      treeFirst = e;
+      treeEnd = e - preselTree->LocalEntry() + chain->GetTree()->GetEntries();
+      if(prefetch && treeNumber + 1 < chain->GetListOfFiles()->GetEntries())
+        PrefetchFile(chain->GetListOfFiles()->At(treeNumber + 1)->GetTitle());
+    }
+    for(int ch = 0; ch < 4; ch++)
+      done[ch] = false;
+    if(cache)
+      RecordKinRecoCache(preselTree, *cache, res, done, hInacc, hAmbig, (kinRecoBlock > 0) ? &batch : NULL, cutFlow);
+    if(skim)
+      SkimEvent(preselTree, *skim, e, res, done, hInacc, hAmbig, (kinRecoBlock > 0) ? &batch : NULL, cutFlow);
+    // generator level top and antitop (prepared once per event if needed)
+    TLorentzVector tGen, tbarGen;
+    bool doneGen = false;
+    // loop over outputs
+    for(int o = 0; o < vecOut.size(); o++)
+    {
+      ZEventRecoOutput& out = vecOut[o];
+      if(out.Type == 2 || out.Type == 3)
+      {
+        preselTree->Load(kReadSetMCType);
+        ZTREE_REQUIRE(preselTree, kReadSetMCType, "EventLoop");
+        // skip background events for MC signal
+        if(out.Type == 2 && preselTree->mcEventType != out.Channel) continue;
+        // skip signal events for MC 'ttbar other' (background)
+        if(out.Type == 3 && preselTree->mcEventType == out.Channel) continue;
+      }
+      // process generator level if needed
+      if(out.Gen)
+      {
+        // prepare four vectors for top and antitop
+        if(!doneGen)
         {
-          trig = true;
-          break;
+          preselTree->Load(kReadSetGen);
+          ZTREE_REQUIRE(preselTree, kReadSetGen, "EventLoop");
+          tGen.SetXYZM(preselTree->mcT[0], preselTree->mcT[1], preselTree->mcT[2], preselTree->mcT[3]);
+          tbarGen.SetXYZM(preselTree->mcTbar[0], preselTree->mcTbar[1], preselTree->mcTbar[2], preselTree->mcTbar[3]);
+          doneGen = true;
         }
-      double met = TMath::Sqrt(TMath::Power(preselTree->metPx, 2.0) + TMath::Power(preselTree->metPy, 2.0));
-      // additional requirement on the missing transverse energy
-      if(trig && met > 40.0)
-        SelectDilepMuMu(preselTree, vecLepM, vecLepP, maxPtDiLep);
+        // fill histos
+        FillHistos(out.VecVarHisto, out.Weight, &tGen, &tbarGen, NULL, NULL, &out.Bank);
+        out.NGen++;
+        continue;
+      }
+      if(out.Type > 1)
+        out.NGen++;
+      
+      // process reco level (once per channel)
+      const int ch = out.Channel;
+      if(!done[ch])
+      {
+        RecoEvent(preselTree, ch, res[ch], hInacc, hAmbig, (kinRecoBlock > 0) ? &batch : NULL, cutFlow ? &cutFlow[ch] : NULL);
+        done[ch] = true;
+      }
+      if(res[ch].Status < 1)
+        continue;
+      // event selection done: increment the counter of selected events
+      out.NSel++;
+      // postponed kinreco: queue histogram filling
+      if(res[ch].BatchIndex >= 0)
+      {
+        ZPendingReco pending;
+        pending.Output = o;
+        pending.BatchIndex = res[ch].BatchIndex;
+        pending.LepM = res[ch].LepM;
+        pending.LepP = res[ch].LepP;
+        vecPending.push_back(pending);
+        continue;
+      }
+      if(res[ch].Status < 2)
+        continue;
+      // successfull kinreco
+      out.NReco++;
+      // fill histograms
+      FillHistos(out.VecVarHisto, out.Weight, res[ch].T, res[ch].Tbar, res[ch].LepM, res[ch].LepP, &out.Bank);
+    } // end loop over outputs
+    // batched kinreco: solve when the block is full
+    if(kinRecoBlock > 0 && batch.NEvents() >= kinRecoBlock)
+      FlushKinRecoBatch(batch, vecPending, vecOut, hInacc, hAmbig, cache);
+  } // end event loop
+  // batched kinreco: remaining events
+  if(batch.NEvents() > 0)
+    FlushKinRecoBatch(batch, vecPending, vecOut, hInacc, hAmbig, cache);
+  // statistics of the last input file
+  if(treeNumber >= 0 && readStats)
+    readStats->AddFile(chain, last - treeFirst);
+  if(profile)
+    profile->Add(gProfileThread);
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>> Store outputs >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Prints event counters of all outputs and stores their histograms in 
+// ROOT files in directory outDir (one file per output).
+//
+void StoreOutputs(std::vector<ZEventRecoOutput>& vecOut, const TString& outDir)
+{
+  for(int o = 0; o < vecOut.size(); o++)
+  {
+    ZEventRecoOutput& out = vecOut[o];
+    printf("****** output: %s   type: %d   channel: %d%s\n", out.Name.Data(), out.Type, out.Channel, out.Gen ? "   (gen)" : "");
+    if(!out.Gen)
+    {
+      // print the numbers of selected events and events with successfull kinematic reconstruction
+      printf("nSel  : %ld\n", out.NSel);
+      printf("nReco : %ld\n", out.NReco);
+    }
+    // for signal MC, print the number of signal events at generator level and detector efficiency
+    // (with and without kinematic reconstruction)
+    if(out.Type == 2) 
+    {
+      printf("nGen  : %d\n", out.NGen);
+      if(!out.Gen)
+        printf("C = %.2f%% (no KINRECO %.2f%%)\n", 100. * out.NReco / out.NGen, 100. * out.NSel / out.NGen);
+    }
+
+    // store histograms in output file
+    TFile* fout = TFile::Open(TString::Format("%s/%s-c%d.root", outDir.Data(), out.Name.Data(), out.Channel), "recreate");
+    fout->cd();
+    StoreHistos(out.VecVarHisto, &out.Bank);
+    fout->Close();
+  }
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>> Profile report >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Prints stage profile of the event loop (see profile.h) and writes it 
+// for each output as a JSON file next to its histogram file (see 
+// StoreOutputs() above), together with event counters, wall and CPU time 
+// of the whole event loop (CPU time of all threads), event rate and 
+// input reading statistics. Stage times are summed over threads. If the 
+// outputs are filled from the kinreco result cache, the report contains 
+// only the histogram filling (no input is read).
+//
+void WriteProfileReport(const std::vector<ZEventRecoOutput>& vecOut, const TString& outDir, const TString& sample, const ZProfile& profile, 
+                        const long nEvents, const int nThreads, const double wall, const double cpu, const Long64_t bytesRead, const int readCalls)
+{
+  const double rate = (wall > 0.0) ? (nEvents / wall) : 0.0;
+  printf("profile: wall %.2f s   CPU %.2f s   %.1f events/s\n", wall, cpu, rate);
+  for(int s = 0; s < kProfNStages; s++)
+    printf("  %-16s calls: %10ld   wall: %8.3f s   CPU: %8.3f s\n", ProfileStageName(s), profile.Calls[s], profile.Wall[s], profile.Cpu[s]);
+  for(int o = 0; o < vecOut.size(); o++)
+  {
+    const ZEventRecoOutput& out = vecOut[o];
+    const TString name = TString::Format("%s/%s-c%d.json", outDir.Data(), out.Name.Data(), out.Channel);
+    FILE* f = fopen(name.Data(), "w");
+    if(!f)
+    {
+      printf("Warning: can not write profile report %s\n", name.Data());
+      continue;
     }
-    // check if there is a dilepton pair found, otherwise skip the event
-    if(maxPtDiLep < 0.0)
+    fprintf(f, "{\n");
+    fprintf(f, "  \"sample\": \"%s\",\n", sample.Data());
+    fprintf(f, "  \"output\": \"%s\",\n", out.Name.Data());
+    fprintf(f, "  \"channel\": %d,\n", out.Channel);
+    fprintf(f, "  \"type\": %d,\n", out.Type);
+    fprintf(f, "  \"gen\": %s,\n", out.Gen ? "true" : "false");
+    fprintf(f, "  \"threads\": %d,\n", nThreads);
+    fprintf(f, "  \"events\": %ld,\n", nEvents);
+    fprintf(f, "  \"nSel\": %ld,\n", out.NSel);
+    fprintf(f, "  \"nReco\": %ld,\n", out.NReco);
+    fprintf(f, "  \"nGen\": %d,\n", out.NGen);
+    fprintf(f, "  \"wallTime\": %.6f,\n", wall);
+    fprintf(f, "  \"cpuTime\": %.6f,\n", cpu);
+    fprintf(f, "  \"eventsPerSecond\": %.3f,\n", rate);
+    fprintf(f, "  \"bytesRead\": %lld,\n", bytesRead);
+    fprintf(f, "  \"readCalls\": %d,\n", readCalls);
+    fprintf(f, "  \"stages\": {\n");
+    for(int s = 0; s < kProfNStages; s++)
+      fprintf(f, "    \"%s\": { \"calls\": %ld, \"wallTime\": %.6f, \"cpuTime\": %.6f }%s\n", ProfileStageName(s), 
+              profile.Calls[s], profile.Wall[s], profile.Cpu[s], (s + 1 < kProfNStages) ? "," : "");
+    fprintf(f, "  }\n");
+    fprintf(f, "}\n");
+    fclose(f);
+  }
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>> Fill outputs from cache >>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Content of kinreco result cache (see kinRecoCache.h) needed for provided 
+// outputs, -1 if the cache can not be used for them (generator level 
+// is cached only for MC signal).
+//
+int KinRecoCacheContent(const std::vector<ZEventRecoOutput>& vecOut)
+{
+  int content = 0;
+  for(int o = 0; o < vecOut.size(); o++)
+  {
+    const ZEventRecoOutput& out = vecOut[o];
+    if(out.Type == 2 || out.Type == 3)
+      content |= kKinRecoCacheMCType;
+    if(out.Gen && out.Type != 2)
+      return -1;
+    content |= out.Gen ? kKinRecoCacheGen : KinRecoCacheChannelBit(out.Channel);
+  }
+  return content;
+}
+
+// Number of events at generator level for reco level output out: events which 
+// pass the MC event type requirement among nEvents processed events 
+// (nEventsType per MC event type), 0 for data.
+int OutputNGen(const ZEventRecoOutput& out, const long nEvents, const long* nEventsType)
+{
+  if(out.Type == 2)
+    return nEventsType[out.Channel];
+  if(out.Type == 3)
+    return nEvents - nEventsType[out.Channel];
+  if(out.Type > 1)
+    return nEvents;
+  return 0;
+}
+
+// Fills outputs (histograms and event counters) from kinreco result cache, 
+// as in EventLoop() above: the histograms are the same, since events are 
+// filled in the same order.
+void FillFromKinRecoCache(const ZKinRecoCache& cache, std::vector<ZEventRecoOutput>& vecOut)
+{
+  for(int o = 0; o < vecOut.size(); o++)
+  {
+    ZEventRecoOutput& out = vecOut[o];
+    // generator level (MC signal)
+    if(out.Gen)
+    {
+      for(int g = 0; g < cache.Gen.size(); g++)
+      {
+        const ZKinRecoCacheGen& gen = cache.Gen[g];
+        if(gen.McEventType != out.Channel)
+          continue;
+        TLorentzVector tGen = gen.T.LorentzVector();
+        TLorentzVector tbarGen = gen.Tbar.LorentzVector();
+        FillHistos(out.VecVarHisto, out.Weight, &tGen, &tbarGen, NULL, NULL, &out.Bank);
+        out.NGen++;
+      }
       continue;
-    // dilepton pair found, now select jets; 
-    // all jets are stored for kinematic reconstruction
-    std::vector<TLorentzVector> vecJets;
-    bool oneBTagJet = false;
-    for(int j = 0; j < preselTree->Njet; j++)
+    }
+    // number of events at generator level
+    out.NGen += OutputNGen(out, cache.NEvents, cache.NEventsType);
+    // reco level
+    for(int r = 0; r < cache.Reco.size(); r++)
     {
-      if(TMath::Abs(preselTree->jetEta[j]) > 2.4)
+      const ZKinRecoCacheReco& rec = cache.Reco[r];
+      if(rec.Channel != out.Channel)
+        continue;
+      if(out.Type == 2 && rec.McEventType != out.Channel)
         continue;
-      TLorentzVector vecJet;
-      vecJet.SetPtEtaPhiM(preselTree->jetPt[j], preselTree->jetEta[j], preselTree->jetPhi[j], preselTree->jetMass[j]);
-      // subtract muon and electron energy fractions
-      double corrE = vecJet.E() - preselTree->jetMuEn[j] - preselTree->jetElEn[j];
-      double corrPt = preselTree->jetPt[j] * corrE / vecJet.E();\
-      // require pT(jet) > 30 GeV
-      if(corrPt < 30.0)
+      if(out.Type == 3 && rec.McEventType == out.Channel)
         continue;
-      TLorentzVector corrVec;
-      corrVec.SetPtEtaPhiE(corrPt, preselTree->jetEta[j], preselTree->jetPhi[j], corrE);
-      // b-tagging: check if there at least one b-tagged jet
-      // for b-tagged jet make the jet mass negative: this is for proper 
-      // identification of b-tagged jets in the kinematic reconstruction
-      if(preselTree->jetBTagDiscr[j] > bTagDiscrL)
+      out.NSel++;
+      if(rec.Status < 2)
+        continue;
+      out.NReco++;
+      FillHistos(out.VecVarHisto, out.Weight, rec.T, rec.Tbar, rec.LepM, rec.LepP, &out.Bank);
+    }
+  }
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>> Close skim >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Writes and deletes all parts of the skim base written in the event loop 
+// (see ZSkimWriter in skim.h).
+//
+void CloseSkim(std::vector<ZSkimWriter*>& vecSkim, const TString& base)
+{
+  if(vecSkim.size() == 0)
+    return;
+  bool ok = true;
+  long nSkim = 0;
+  for(int p = 0; p < vecSkim.size(); p++)
+  {
+    ok = vecSkim[p]->Close() && ok;
+    nSkim += vecSkim[p]->NSkim;
+    delete vecSkim[p];
+  }
+  vecSkim.clear();
+  if(ok)
+    printf("skim written: %s_*.root   nSkim: %ld\n", base.Data(), nSkim);
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>> Basic routine for ttbar event reconstruction >>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// All outputs in in.VecOutput are filled in one loop over the input 
+// sample, i.e. the (possibly large) input ntuples are read only once: 
+// each event is routed to every output it belongs to, and reco level 
+// reconstruction is done once per event and decay channel.
+//
+// If in.NThreads > 1, the events are split into contiguous ranges 
+// (aligned to input file boundaries, if there are enough files) 
+// processed in parallel: each thread has its own TChain, ZTree and 
+// histogram bank shards, which are merged afterwards in a fixed order 
+// (see ZHistoBank::MergeShards() in histoBank.h), the result is 
+// bin-identical to the serial processing (histogram statistics for mean 
+// and RMS may differ in the last bits).
+//
+void eventreco(ZEventRecoInput in)
+{ 
+  // single output (old style input), make it from the input settings
+  if(in.VecOutput.size() == 0)
+    in.AddOutput(in.Name, in.Channel, in.Type, in.Gen, in.VecVarHisto);
+  std::vector<ZEventRecoOutput>& vecOut = in.VecOutput;
+  // all outputs are filled with the weight of the input sample
+  for(int o = 0; o < vecOut.size(); o++)
+    vecOut[o].Weight = in.Weight;
+  // histograms of all outputs are created from their prototypes 
+  // (and deleted together with the input at the end) and booked in 
+  // the histogram banks of the outputs, which are filled in the event loop
+  for(int o = 0; o < vecOut.size(); o++)
+    for(int h = 0; h < vecOut[o].VecVarHisto.size(); h++)
+    {
+      vecOut[o].VecVarHisto[h].Instantiate();
+      vecOut[o].VecVarHisto[h].Book(vecOut[o].Bank);
+    }
+
+  printf("****** EVENTRECO ******\n");
+  printf("input sample: %s\n", in.Name.Data());
+  for(int o = 0; o < vecOut.size(); o++)
+    printf("output: %s   type: %d   channel: %d%s\n", vecOut[o].Name.Data(), vecOut[o].Type, vecOut[o].Channel, vecOut[o].Gen ? "   (gen)" : "");
+  
+  // directory for output ROOT files with histograms
+  TString outDir = gHistDir; 
+
+  // this flag determines whether generator level information is available
+  // (should be available for signal MC)
+  bool flagMC = false;
+  // branches needed for all outputs
+  ZReadSet readSet = 0;
+  for(int o = 0; o < vecOut.size(); o++)
+  {
+    if(vecOut[o].Type == 2 || vecOut[o].Type == 3)
+      flagMC = true;
+    readSet |= ReadSetOutput(vecOut[o]);
+  }
+
+  // kinreco result cache (see kinRecoCache.h): if available, outputs are 
+  // filled from it and the input ntuples are not read, otherwise it is 
+  // written after the event loop
+  ZKinRecoCache* cache = NULL;
+  TString cacheFile;
+  if(in.KinRecoCache)
+  {
+    const int content = KinRecoCacheContent(vecOut);
+    if(content < 0)
+      printf("Warning: kinreco cache is not used (generator level is cached only for MC signal)\n");
+    else
+    {
+      // kinreco variant: tabulated neutrino weights and quartic equation solver (see kinReco.h)
+      const int variant = (gKinRecoLandau == kLandauTable) | (gKinRecoQuartic << 1);
+      cache = new ZKinRecoCache(KinRecoCacheKey(in.VecInFile, in.MaxNEvents, variant), content);
+      cacheFile = TString::Format("%s/%s-%016llx.zkrc", gCacheDir.Data(), in.Name.Data(), cache->Key);
+      if(cache->Read(cacheFile))
       {
-        corrVec.SetPtEtaPhiM(corrVec.Pt(), corrVec.Eta(), corrVec.Phi(), -1 * corrVec.M());
-        oneBTagJet = true;
+        printf("kinreco cache: %s   nEvents: %ld\n", cacheFile.Data(), cache->NEvents);
+        // the profile report is written as well: no event loop stages, only histogram filling
+        gProfileThread.Reset();
+        TStopwatch timer;
+        timer.Start();
+        FillFromKinRecoCache(*cache, vecOut);
+        timer.Stop();
+        StoreOutputs(vecOut, outDir);
+        if(kProfileEnabled)
+          WriteProfileReport(vecOut, outDir, in.Name, gProfileThread, cache->NEvents, 1, timer.RealTime(), timer.CpuTime(), 0, 0);
+        delete cache;
+        return;
       }
-      vecJets.push_back(corrVec);
+      readSet |= kReadSetEvent;
     }
-    // if there are no two jets, skip the event
-    if(vecJets.size() < 2)
-      continue;
-    // require at least one b-tagged jet
-    if(!oneBTagJet)
-      continue;
-    // event selection done: increment the counter of selected events
-    nSel++;
-    
-    // now run kinematic reconstruction to restore the top and antitop momenta
-    TLorentzVector t, tbar;
-    // call main routine, see kinReco.h for description
-    int status = KinRecoDilepton(vecLepM, vecLepP, vecJets, preselTree->metPx, preselTree->metPy, t, tbar, hInacc, hAmbig);
-    // returned status is 1 for successfull kinreco, 0 otherwise
-    // t, tbar are vectors with single "best" solution (if kinreco was successfull)
-    //printf("STATUS: %d\n", status);
-    if(status > 0) // successfull kinreco
-    {
-      // print the top and antitop momenta, if needed
-      //printf("top:      (%8.3f  %8.3f  %8.3f  %8.3f)\n", t.X(), t.Y(), t.Z(), t.M());
-      //printf("antitop:  (%8.3f  %8.3f  %8.3f  %8.3f)\n", tbar.X(), tbar.Y(), tbar.Z(), tbar.M());
-      nReco++;
-      
-      // fill histograms
-      double w = in.Weight;
-      FillHistos(in.VecVarHisto, w, &t, &tbar, &vecLepM, &vecLepP);
-    } // end kinreco
-  } // end event loop
+  }
+
+  // skim (see skim.h): if available, it is read instead of the input ntuples 
+  // (and event counters at generator level are taken from its metadata), 
+  // otherwise it is written in the event loop (all branches are read)
+  ZSkimInfo skimInfo;
+  bool fromSkim = false;
+  TString skimBase;
+  unsigned long long skimKey = 0;
+  int skimContent = 0;
+  std::vector<TString> skimInputs = in.VecInFile;
+  if(in.UseSkim)
+  {
+    skimContent = KinRecoCacheContent(vecOut);
+    if(skimContent < 0)
+      printf("Warning: skim is not used (generator level is skimmed only for MC signal)\n");
+    else
+    {
+      skimKey = SkimKey(in.VecInFile, in.MaxNEvents, skimContent);
+      skimBase = TString::Format("%s/%s-%016llx", gSkimDir.Data(), in.Name.Data(), skimKey);
+      if(skimInfo.Read(skimBase, skimKey))
+      {
+        printf("skim: %s_*.root   nEvents: %ld   nSkim: %ld\n", skimBase.Data(), skimInfo.NEvents, skimInfo.NSkim);
+        in.VecInFile = skimInfo.Files;
+        in.MaxNEvents = 100e10;
+        fromSkim = true;
+      }
+      else
+      {
+        readSet = kReadSetAll;
+        mkdir(gSkimDir.Data(), 0755);
+      }
+    }
+  }
+  const bool writeSkim = in.UseSkim && skimContent >= 0 && !fromSkim;
+  const TString skimStamp = TString::Format("%lx-%x", (long)time(NULL), (int)getpid());
+  std::vector<ZSkimWriter*> vecSkim;
   
-  // print the numbers of selected events and events with successfull kinematic reconstruction
-  printf("nSel  : %ld\n", nSel);
-  printf("nReco : %ld\n", nReco);
-  // for signal MC, print the number of signal events at generator level and detector efficiency
-  // (with and without kinematic reconstruction)
-  if(in.Type == 2) 
+  // input files index (numbers of entries are known without opening files)
+  ZChainIndex* index = NULL;
+  if(in.UseIndex)
   {
-    printf("nGen  : %d\n", nGen);
-    printf("C = %.2f%% (no KINRECO %.2f%%)\n", 100. * nReco / nGen, 100. * nSel / nGen);
+    index = new ZChainIndex("tree");
+    for(int f = 0; f < in.VecInFile.size(); f++)
+      index->Add(in.VecInFile[f]);
   }
+  // preselection index (needs all input files indexed, not used if the skim is written, 
+  // since it needs also events without jets)
+  ZPreselIndex* presel = NULL;
+  if(in.UsePreselIndex)
+  {
+    if(!index || !index->IsComplete())
+      printf("Warning: preselection index is not used (input files are not indexed, see UseIndex)\n");
+    else if(writeSkim)
+      printf("Warning: preselection index is not used while the skim is written\n");
+    else
+    {
+      presel = new ZPreselIndex("tree");
+      presel->Add(*index);
+    }
+  }
+  // input tree
+  ZTree* preselTree = MakeInputTree(in, flagMC, readSet, index);
+  TChain* chain = (TChain*)preselTree->fChain;
+    
+  // histograms for kinematic reconstruction debugging
+  // (not needed in physics analysis, not stored)
+  TH1D* hInacc = new TH1D("hInacc", "KinReco inaccuracy", 1000, 0.0, 100.0);
+  TH1D* hAmbig = new TH1D("hAmbig", "KinReco ambiguity", 100, 0.0, 100.0);
+  hInacc->SetDirectory(0);
+  hAmbig->SetDirectory(0);
 
-  // store histograms, close output file
-  fout->cd();
-  StoreHistos(in.VecVarHisto);
-  fout->Close();
+  // determine number of events
+  long nEvents = chain->GetEntries();
+  //limit it if exceeds the specified maximum number
+  if(nEvents > in.MaxNEvents)
+    nEvents = in.MaxNEvents;
+  printf("nEvents: %ld\n", nEvents);
+  // input reading statistics
+  ZReadStats readStats;
+  const int readCalls0 = TFile::GetFileReadCalls();
+  const Long64_t bytesRead0 = TFile::GetFileBytesRead();
+  // kinreco pruning statistics (see KinRecoDileptonPruned() in kinReco.h)
+  const long pruneNEvents0 = gKinRecoPruneNEvents;
+  const long pruneNPairs0 = gKinRecoPruneNPairs;
+  const long pruneNSkipped0 = gKinRecoPruneNSkipped;
+  // stage profile and time of the event loop (see profile.h)
+  ZProfile profile;
+  // reco level cut flow per channel (index 1 ee, 2 mumu, 3 emu, see cutFlow.h)
+  std::vector<ZCutFlow> cutFlow(4, ZCutFlow(in.CutFlow == 2));
+  TStopwatch timer;
+  timer.Start();
+
+  int nThreads = in.NThreads;
+  if(nThreads > nEvents)
+    nThreads = (nEvents > 0) ? nEvents : 1;
+  if(nThreads <= 1)
+  {
+    // serial event loop
+    if(writeSkim)
+      vecSkim.push_back(new ZSkimWriter(skimBase, 0, 1, skimKey, skimContent, skimStamp, skimInputs));
+    EventLoop(preselTree, vecOut, 0, nEvents, hInacc, hAmbig, &readStats, in.Prefetch, in.KinRecoBlock, cache, 
+              writeSkim ? vecSkim[0] : NULL, presel, &profile, in.CutFlow ? &cutFlow[0] : NULL);
+    CloseSkim(vecSkim, skimBase);
+  }
+  else
+  {
+    printf("nThreads: %d\n", nThreads);
+    ROOT::EnableThreadSafety();
+    // split events into ranges: if all input files are indexed, align them to 
+    // tree cluster boundaries (threads do not read the same baskets), otherwise 
+    // align them to file boundaries (chain->GetEntries() above has opened all 
+    // files, so their offsets are known) if there are enough files, otherwise 
+    // split uniformly
+    std::vector<long> vecFirst(nThreads + 1);
+    const int nTrees = chain->GetNtrees();
+    const Long64_t* offsets = chain->GetTreeOffset();
+    for(int t = 0; t <= nThreads; t++)
+    {
+      long first = nEvents * t / nThreads;
+      if(index && index->IsComplete() && t > 0 && t < nThreads)
+      {
+        const std::vector<Long64_t>& clusters = index->ClusterStarts();
+        std::vector<Long64_t>::const_iterator it = std::lower_bound(clusters.begin(), clusters.end(), (Long64_t)first);
+        first = (it != clusters.end()) ? *it : nEvents;
+        if(first < vecFirst[t - 1] || first > nEvents)
+          first = nEvents;
+      }
+      else if(nTrees >= nThreads && t > 0 && t < nThreads)
+      {
+        for(int f = 0; f < nTrees; f++)
+          if(offsets[f] >= first)
+          {
+            first = offsets[f];
+            break;
+          }
+        if(first < vecFirst[t - 1] || first > nEvents)
+          first = nEvents;
+      }
+      vecFirst[t] = first;
+    }
+    // per thread trees, outputs with histogram shards and debugging histograms; 
+    // everything is created here, before the threads are started
+    std::vector<ZTree*> vecTree(nThreads);
+    std::vector<std::vector<ZEventRecoOutput> > vecOutShard(nThreads);
+    std::vector<TH1D*> vecInacc(nThreads), vecAmbig(nThreads);
+    std::vector<ZReadStats> vecReadStats(nThreads);
+    std::vector<ZProfile> vecProfile(nThreads);
+    std::vector<std::vector<ZCutFlow> > vecCutFlow(nThreads, cutFlow);
+    std::vector<ZKinRecoCache> vecCache(nThreads, cache ? *cache : ZKinRecoCache());
+    for(int t = 0; t < nThreads; t++)
+    {
+      vecTree[t] = MakeInputTree(in, flagMC, readSet, index);
+      vecOutShard[t].reserve(vecOut.size());
+      for(int o = 0; o < vecOut.size(); o++)
+        vecOutShard[t].push_back(vecOut[o].MakeShard());
+      vecInacc[t] = new TH1D(*hInacc);
+      vecAmbig[t] = new TH1D(*hAmbig);
+      vecInacc[t]->SetDirectory(0);
+      vecAmbig[t]->SetDirectory(0);
+      if(writeSkim)
+        vecSkim.push_back(new ZSkimWriter(skimBase, t, nThreads, skimKey, skimContent, skimStamp, skimInputs));
+    }
+    // run threads
+    std::vector<std::thread> vecThread;
+    for(int t = 0; t < nThreads; t++)
+      vecThread.push_back(std::thread(EventLoop, vecTree[t], std::ref(vecOutShard[t]), vecFirst[t], vecFirst[t + 1], vecInacc[t], vecAmbig[t], &vecReadStats[t], in.Prefetch, in.KinRecoBlock, 
+                                          cache ? &vecCache[t] : NULL, writeSkim ? vecSkim[t] : NULL, presel, &vecProfile[t], 
+                                          in.CutFlow ? &vecCutFlow[t][0] : NULL));
+    for(int t = 0; t < nThreads; t++)
+      vecThread[t].join();
+    // skim parts are closed before their input chains are deleted
+    CloseSkim(vecSkim, skimBase);
+    // merge shards in fixed order
+    for(int o = 0; o < vecOut.size(); o++)
+    {
+      ZEventRecoOutput& out = vecOut[o];
+      for(int t = 0; t < nThreads; t++)
+      {
+        out.NSel += vecOutShard[t][o].NSel;
+        out.NReco += vecOutShard[t][o].NReco;
+        out.NGen += vecOutShard[t][o].NGen;
+      }
+      std::vector<const ZHistoBank*> shards(nThreads);
+      for(int t = 0; t < nThreads; t++)
+        shards[t] = &vecOutShard[t][o].Bank;
+      out.Bank.MergeShards(shards, out.Weight);
+    }
+    for(int t = 0; t < nThreads; t++)
+    {
+      readStats.Add(vecReadStats[t]);
+      profile.Add(vecProfile[t]);
+      for(int ch = 1; ch <= 3; ch++)
+        cutFlow[ch].Add(vecCutFlow[t][ch]);
+      if(cache)
+        cache->Add(vecCache[t]);
+      hInacc->Add(vecInacc[t]);
+      hAmbig->Add(vecAmbig[t]);
+      delete vecInacc[t];
+      delete vecAmbig[t];
+      delete vecTree[t]->fChain;
+      delete vecTree[t];
+    }
+  }
+  timer.Stop();
+  const int readCalls = TFile::GetFileReadCalls() - readCalls0;
+  const Long64_t bytesRead = TFile::GetFileBytesRead() - bytesRead0;
+  // print input reading statistics (for tuning of cache settings)
+  printf("input files: %d   read calls: %d   read MB: %.1f   cache hit rate: %.1f%%\n", readStats.NFiles, 
+    readCalls, bytesRead / 1048576.0, 100.0 * readStats.HitRate());
+  if(gKinRecoPrune)
+    KinRecoPrunePrint(pruneNEvents0, pruneNPairs0, pruneNSkipped0);
+  // print cut flow (adaptive order: cuts in the optimal order for all threads)
+  for(int ch = 1; ch <= 3; ch++)
+  {
+    if(!in.CutFlow || cutFlow[ch].NEvents == 0)
+      continue;
+    if(in.CutFlow == 2)
+      cutFlow[ch].Reorder();
+    cutFlow[ch].Print(ch);
+  }
+  // skim input: processed input events are known from the skim metadata only
+  if(fromSkim)
+  {
+    for(int o = 0; o < vecOut.size(); o++)
+      if(!vecOut[o].Gen)
+        vecOut[o].NGen = OutputNGen(vecOut[o], skimInfo.NEvents, skimInfo.NEventsType);
+    if(cache)
+    {
+      cache->NEvents = skimInfo.NEvents;
+      for(int t = 0; t < 4; t++)
+        cache->NEventsType[t] = skimInfo.NEventsType[t];
+    }
+  }
+  // store kinreco result cache
+  if(cache)
+  {
+    mkdir(gCacheDir.Data(), 0755);
+    if(cache->Write(cacheFile))
+      printf("kinreco cache written: %s\n", cacheFile.Data());
+    delete cache;
+  }
+  
+  StoreOutputs(vecOut, outDir);
+  if(kProfileEnabled)
+    WriteProfileReport(vecOut, outDir, in.Name, profile, nEvents, nThreads, timer.RealTime(), timer.CpuTime(), bytesRead, readCalls);
+  delete hInacc;
+  delete hAmbig;
+  // (deleting the chain closes its input files and their read caches)
+  delete preselTree->fChain;
+  delete preselTree;
+  delete presel;
+  delete index;
 }
 
 #endif
@@ -0,0 +1,85 @@
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>> Lightweight four vector >>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// Four momenta in event selection and kinematic reconstruction (see
+// selection.h, eventReco.h and kinReco.h) are stored as four doubles
+// (trivially copyable, no TObject overhead); conversion to TLorentzVector
+// is done only when histograms are filled.
+// All routines give exactly the same numbers as the corresponding
+// TLorentzVector methods (the same expressions in the same order).
+
+#ifndef TTBAR_FOURVECTOR_H
+#define TTBAR_FOURVECTOR_H
+
+// C++ library or ROOT header files
+#include <TMath.h>
+#include <TLorentzVector.h>
+#include <cmath>
+
+struct ZFourVector
+{
+  double Px, Py, Pz, E; // four momentum
+
+  // constructors (default one leaves components uninitialised)
+  ZFourVector() = default;
+  ZFourVector(const double px, const double py, const double pz, const double e): Px(px), Py(py), Pz(pz), E(e) {;}
+
+  // set momentum and mass, as TLorentzVector::SetXYZM()
+  void SetXYZM(const double px, const double py, const double pz, const double m)
+  {
+    Px = px;
+    Py = py;
+    Pz = pz;
+    if(m >= 0.0)
+      E = TMath::Sqrt(px * px + py * py + pz * pz + m * m);
+    else
+      E = TMath::Sqrt(TMath::Max(px * px + py * py + pz * pz - m * m, 0.0));
+  }
+
+  // set pT, eta, phi and mass, as TLorentzVector::SetPtEtaPhiM()
+  void SetPtEtaPhiM(double pt, const double eta, const double phi, const double m)
+  {
+    pt = TMath::Abs(pt);
+    SetXYZM(pt * TMath::Cos(phi), pt * TMath::Sin(phi), pt * sinh(eta), m);
+  }
+
+  // set pT, eta, phi and energy, as TLorentzVector::SetPtEtaPhiE()
+  void SetPtEtaPhiE(double pt, const double eta, const double phi, const double e)
+  {
+    pt = TMath::Abs(pt);
+    Px = pt * TMath::Cos(phi);
+    Py = pt * TMath::Sin(phi);
+    Pz = pt * sinh(eta);
+    E = e;
+  }
+
+  // transverse momentum
+  double Pt() const { return TMath::Sqrt(Px * Px + Py * Py); }
+
+  // invariant mass (negative for space-like vectors)
+  double M() const
+  {
+    const double mm = E * E - (Px * Px + Py * Py + Pz * Pz);
+    return (mm < 0.0) ? -TMath::Sqrt(-mm) : TMath::Sqrt(mm);
+  }
+
+  // sum and difference
+  ZFourVector operator+(const ZFourVector& v) const { return ZFourVector(Px + v.Px, Py + v.Py, Pz + v.Pz, E + v.E); }
+  ZFourVector operator-(const ZFourVector& v) const { return ZFourVector(Px - v.Px, Py - v.Py, Pz - v.Pz, E - v.E); }
+
+  // comparison (all components)
+  bool operator==(const ZFourVector& v) const { return Px == v.Px && Py == v.Py && Pz == v.Pz && E == v.E; }
+  bool operator!=(const ZFourVector& v) const { return !(*this == v); }
+
+  // conversion to TLorentzVector (for histograms)
+  TLorentzVector LorentzVector() const { return TLorentzVector(Px, Py, Pz, E); }
+};
+
+// jet for kinematic reconstruction: momentum and b-tagging flag
+struct ZJet
+{
+  ZFourVector P; // four momentum
+  bool BTag; // true for b-tagged jet
+};
+
+#endif
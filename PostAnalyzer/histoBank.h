@@ -0,0 +1,262 @@
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>> Histogram bank >>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// Bin contents, sums of squares of weights, statistics and numbers of
+// entries of all histograms of one output (see eventReco.h) are stored in
+// one contiguous array; bin edges of all axes are in another one.
+// Histograms are booked from TH1D or TH2D (binning only) and filled in the
+// event loop without any call to ROOT, the results are copied to the
+// histograms when they are stored (see Store()).
+// Fill() gives exactly the same numbers as TH1::Fill() and TH2::Fill()
+// (the same bin lookup as TAxis::FindBin() and the same expressions in
+// the same order); the bin of variable width is found by counting the
+// bin edges below the value (no branches, only few bins are used).
+// For the parallel event loop each thread has its own bank (shard, see
+// SetShard()) which may be filled with unit weight only, so all fills of
+// an output must have the same weight; the banks are merged with
+// MergeShards(): bin contents,
+// errors and numbers of entries do not depend on the number of threads,
+// the statistics (mean and RMS) may differ in the last bits.
+
+#ifndef TTBAR_HISTOBANK_H
+#define TTBAR_HISTOBANK_H
+
+// C++ library or ROOT header files
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <TH1.h>
+#include <TAxis.h>
+#include <TArrayD.h>
+
+class ZHistoBank
+{
+  private:
+    // axis binning
+    struct ZBankAxis
+    {
+      int N; // number of bins
+      double Min, Max; // range
+      int Edges; // first bin edge in zEdges (for variable bins), -1 for fixed bins
+    };
+    // booked histogram
+    struct ZBankHisto
+    {
+      ZBankAxis X, Y; // axes (Y.N = 0 for 1D histogram)
+      int NCells; // number of bins including underflow and overflow
+      int Offset; // first bin content in zData, followed by NCells sums of
+                  // squares of weights, kNStats statistics and number of entries
+    };
+    // statistics as in TH1::GetStats(): sum w, w^2, w*x, w*x^2, w*y, w*y^2, w*x*y
+    static const int kNStats = 7;
+
+    std::vector<ZBankHisto> zHistos; // booked histograms
+    std::vector<double> zEdges; // bin edges of all axes with variable bins
+    std::vector<double> zData; // contents, sums of squares of weights, statistics and entries
+    bool zShard; // true for shard of the parallel event loop (unit weight only)
+
+    // fills of shards must have unit weight (see MergeShards())
+    void CheckShardWeight(const double w) const
+    {
+      if(zShard && w != 1.0)
+      {
+        printf("Error in ZHistoBank::Fill(): weight %f in shard bank (only unit weight is allowed)\n", w);
+        exit(1);
+      }
+    }
+
+    // book axis
+    ZBankAxis BookAxis(const TAxis* axis)
+    {
+      ZBankAxis a;
+      a.N = axis->GetNbins();
+      a.Min = axis->GetXmin();
+      a.Max = axis->GetXmax();
+      a.Edges = -1;
+      const TArrayD* bins = axis->GetXbins();
+      if(bins->GetSize() > 0)
+      {
+        a.Edges = zEdges.size();
+        for(int i = 0; i <= a.N; i++)
+          zEdges.push_back(bins->At(i));
+      }
+      return a;
+    }
+
+    // bin number for value x, as TAxis::FindBin()
+    // (0 for underflow, N + 1 for overflow)
+    inline int FindBin(const ZBankAxis& a, const double x) const
+    {
+      if(x < a.Min)
+        return 0;
+      if(!(x < a.Max))
+        return a.N + 1;
+      if(a.Edges < 0)
+        return 1 + int(a.N * (x - a.Min) / (a.Max - a.Min));
+      const double* edges = &zEdges[a.Edges];
+      int bin = 1;
+      for(int i = 1; i < a.N; i++)
+        bin += (x >= edges[i]);
+      return bin;
+    }
+
+  public:
+    // constructor
+    ZHistoBank(): zShard(false) {}
+
+    // mark the bank as shard of the parallel event loop (to be filled with unit weight only)
+    void SetShard(const bool shard) { zShard = shard; }
+
+    // book histogram with binning of h (1D or 2D), returns its index in the bank
+    int Book(const TH1* h)
+    {
+      ZBankHisto b;
+      b.X = BookAxis(h->GetXaxis());
+      b.NCells = b.X.N + 2;
+      b.Y.N = 0;
+      if(h->GetDimension() == 2)
+      {
+        b.Y = BookAxis(h->GetYaxis());
+        b.NCells *= b.Y.N + 2;
+      }
+      b.Offset = zData.size();
+      zData.resize(zData.size() + 2 * b.NCells + kNStats + 1, 0.0);
+      zHistos.push_back(b);
+      return zHistos.size() - 1;
+    }
+
+    // fill 1D histogram h with value x and weight w, as TH1::Fill()
+    inline void Fill(const int h, const double x, const double w)
+    {
+      CheckShardWeight(w);
+      const ZBankHisto& b = zHistos[h];
+      const int bin = FindBin(b.X, x);
+      double* data = &zData[b.Offset];
+      double* stats = data + 2 * b.NCells;
+      stats[kNStats] += 1;
+      data[bin] += w;
+      data[b.NCells + bin] += w * w;
+      if(bin == 0 || bin > b.X.N)
+        return;
+      stats[0] += w;
+      stats[1] += w * w;
+      stats[2] += w * x;
+      stats[3] += w * x * x;
+    }
+
+    // fill 2D histogram h with values x, y and weight w, as TH2::Fill()
+    inline void Fill(const int h, const double x, const double y, const double w)
+    {
+      CheckShardWeight(w);
+      const ZBankHisto& b = zHistos[h];
+      const int binx = FindBin(b.X, x);
+      const int biny = FindBin(b.Y, y);
+      const int bin = biny * (b.X.N + 2) + binx;
+      double* data = &zData[b.Offset];
+      double* stats = data + 2 * b.NCells;
+      stats[kNStats] += 1;
+      data[bin] += w;
+      data[b.NCells + bin] += w * w;
+      if(binx == 0 || binx > b.X.N || biny == 0 || biny > b.Y.N)
+        return;
+      stats[0] += w;
+      stats[1] += w * w;
+      stats[2] += w * x;
+      stats[3] += w * x * x;
+      stats[4] += w * y;
+      stats[5] += w * y * y;
+      stats[6] += w * x * y;
+    }
+
+    // set all contents to zero (booked histograms are kept)
+    void Reset()
+    {
+      std::fill(zData.begin(), zData.end(), 0.0);
+    }
+
+    // merge shards (banks with the same booked histograms filled with unit
+    // weight by threads) into this bank, which must be empty: bin contents
+    // are exact numbers of entries, and since all entries have the same
+    // weight w, the bin with n entries gets w added n times, as in the
+    // serial event loop; these sums depend on n only and are computed once
+    // for all n up to the largest bin (cost proportional to the number of
+    // bins and the largest bin, not to the number of entries), so the
+    // result is bin-identical independently of the number of threads and
+    // of the splitting of events; statistics used for mean and RMS are
+    // merged as w * sum(x) instead of sum(w * x) of the serial loop (and
+    // summed in a different order), so they may differ in the last bits
+    void MergeShards(const std::vector<const ZHistoBank*>& shards, const double w)
+    {
+      for(int s = 0; s < shards.size(); s++)
+        if(!shards[s]->zShard)
+        {
+          printf("Error in ZHistoBank::MergeShards(): bank %d is not a shard\n", s);
+          exit(1);
+        }
+      // numbers of entries in all cells (contents only)
+      std::vector<long> counts(zData.size(), 0);
+      long nMax = 0;
+      for(int h = 0; h < zHistos.size(); h++)
+      {
+        const ZBankHisto& b = zHistos[h];
+        for(int bin = 0; bin < b.NCells; bin++)
+        {
+          long& n = counts[b.Offset + bin];
+          for(int s = 0; s < shards.size(); s++)
+            n += (long)(shards[s]->zData[b.Offset + bin] + 0.5);
+          nMax = std::max(nMax, n);
+        }
+      }
+      // sums of n weights and of n squares of weights, added one by one
+      std::vector<double> sumW(nMax + 1, 0.0), sumW2(nMax + 1, 0.0);
+      for(long n = 1; n <= nMax; n++)
+      {
+        sumW[n] = sumW[n - 1] + w;
+        sumW2[n] = sumW2[n - 1] + w * w;
+      }
+      for(int h = 0; h < zHistos.size(); h++)
+      {
+        const ZBankHisto& b = zHistos[h];
+        double* data = &zData[b.Offset];
+        for(int bin = 0; bin < b.NCells; bin++)
+        {
+          const long n = counts[b.Offset + bin];
+          data[bin] = sumW[n];
+          data[b.NCells + bin] = sumW2[n];
+        }
+        // statistics were accumulated with unit weight
+        double statsSum[kNStats + 1] = { 0.0 };
+        for(int s = 0; s < shards.size(); s++)
+          for(int i = 0; i <= kNStats; i++)
+            statsSum[i] += shards[s]->zData[b.Offset + 2 * b.NCells + i];
+        double* stats = data + 2 * b.NCells;
+        for(int i = 0; i < kNStats; i++)
+          stats[i] = statsSum[i] * ((i == 1) ? (w * w) : w);
+        stats[kNStats] = statsSum[kNStats];
+      }
+    }
+
+    // copy booked histogram h (bin contents, errors, statistics and number
+    // of entries) to histo (with the same binning, previous content is replaced)
+    void Store(const int h, TH1* histo) const
+    {
+      const ZBankHisto& b = zHistos[h];
+      const double* data = &zData[b.Offset];
+      if(histo->GetSumw2N() == 0)
+        histo->Sumw2();
+      double* sumw2 = histo->GetSumw2()->fArray;
+      for(int bin = 0; bin < b.NCells; bin++)
+      {
+        histo->SetBinContent(bin, data[bin]);
+        sumw2[bin] = data[b.NCells + bin];
+      }
+      double stats[kNStats];
+      for(int i = 0; i < kNStats; i++)
+        stats[i] = data[2 * b.NCells + i];
+      histo->PutStats(stats);
+      histo->SetEntries(data[2 * b.NCells + kNStats]);
+    }
+};
+
+#endif
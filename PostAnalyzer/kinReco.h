@@ -10,6 +10,10 @@
 #ifndef TTBAR_KINRECO_H
 #define TTBAR_KINRECO_H
 
+// additional files from this analysis 
+#include "quartic.h"
+#include "landau.h"
+#include "fourVector.h"
 // C++ library or ROOT header files
 #include <TMath.h>
 #include <Math/Polynomial.h>
@@ -17,10 +21,183 @@
 #include <TH1D.h>
 #include <vector>
 #include <complex>
+#include <cstdio>
+#include <mutex>
+#include <atomic>
 
 // debugging level (0 for silence, > 0 for some messages)
 int gDebug = 0;
 
+// maximum number of jets in kinematic reconstruction (the same as ZTree::maxNjet, see tree.h)
+const int kinRecoMaxNJets = 25;
+
+// quartic equation solver used in the kinematic reconstruction:
+//   kQuarticROOT: ROOT::Math::Polynomial::FindRealRoots() (the original one), default
+//   kQuarticAnalytic: closed-form solver (see quartic.h), faster, 
+//                     default if compiled with -DKINRECO_ANALYTIC_QUARTIC
+// can be changed at run time (see ttbarMakeHist.cxx); near a double root 
+// the solvers may find different numbers of real roots (ROOT drops roots 
+// with non-zero imaginary part), so compare them with ttbarBench.cxx on 
+// recorded input before using the closed-form one
+enum EKinRecoQuartic { kQuarticAnalytic = 0, kQuarticROOT = 1 };
+#ifdef KINRECO_ANALYTIC_QUARTIC
+int gKinRecoQuartic = kQuarticAnalytic;
+#else
+int gKinRecoQuartic = kQuarticROOT;
+#endif
+
+// neutrino energy weights (Landau function, see SolveKinRecoDileptonPair()):
+//   kLandauExact: TMath::Landau() (the original one), default
+//   kLandauTable: tabulated approximation (see landau.h)
+//   kLandauValidate: both are used in KinRecoDilepton(), the result with TMath::Landau() 
+//                    is returned and events where the tabulated weights would select 
+//                    another solution are counted (see KinRecoLandauValidationPrint())
+// can be changed at run time (see ttbarMakeHist.cxx and ttbarBench.cxx)
+enum EKinRecoLandau { kLandauExact = 0, kLandauTable = 1, kLandauValidate = 2 };
+int gKinRecoLandau = kLandauExact;
+
+// if true, KinRecoDilepton() solves jet pairs ordered by the number of b-tagged jets 
+// and skips pairs which can not change the selected solution (see KinRecoDileptonPruned()), 
+// the result is the same as without pruning
+bool gKinRecoPrune = false;
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>> Neutrino weights >>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// mean and sigma of Landau distribution for neutrino momentum spectrum (see DESY-THESIS-2012-037)
+const double kinRecoLandauMean = 58.0;
+const double kinRecoLandauSigma = 22.0;
+
+// table of Landau function for neutrino energies 0 - 1500 GeV in 0.5 GeV steps 
+// (built at the first call, see landau.h)
+const ZLandauTable& KinRecoLandauTable()
+{
+  static const ZLandauTable table(kinRecoLandauMean, kinRecoLandauSigma, 0.0, 1500.0, 3000);
+  return table;
+}
+
+// weight of neutrino with energy e with provided method (see EKinRecoLandau above, 
+// kLandauValidate gives TMath::Landau())
+inline double KinRecoLandauWeight(const double e, const int landau = gKinRecoLandau)
+{
+  if(landau == kLandauTable)
+    return KinRecoLandauTable().Eval(e);
+  return TMath::Landau(e, kinRecoLandauMean, kinRecoLandauSigma);
+}
+
+// validation counters (kLandauValidate): numbers of events with solution 
+// and of events where tabulated weights select another solution or status
+std::atomic<long> gKinRecoLandauNEvents(0);
+std::atomic<long> gKinRecoLandauNDiffer(0);
+
+// print validation counters
+void KinRecoLandauValidationPrint()
+{
+  printf("Landau weight validation: %ld events with kinreco solution, %ld with different solution from tabulated weights "
+         "(table max relative error %e)\n", gKinRecoLandauNEvents.load(), gKinRecoLandauNDiffer.load(), KinRecoLandauTable().MaxRelError());
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>> Quartic roots >>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// Real roots of pars[0] + pars[1]*x + ... + pars[4]*x^4 = 0 with provided solver 
+// (see EKinRecoQuartic above) stored in roots (at most 4), returns their number.
+// The ROOT solver is used also if the closed-form one can not handle the equation 
+// (not a proper quartic).
+int KinRecoQuarticRoots(const double* pars, double* roots, const int solver = gKinRecoQuartic)
+{
+  if(solver == kQuarticAnalytic)
+  {
+    const int n = SolveQuarticReal(pars, roots);
+    if(n >= 0)
+      return n;
+  }
+  // (polynomial is created once per thread and reused)
+  static thread_local ROOT::Math::Polynomial eq(4);
+  eq.SetParameters(pars);
+  std::vector<double> vecRoots = eq.FindRealRoots();
+  const int n = std::min((int)vecRoots.size(), 4);
+  for(int r = 0; r < n; r++)
+    roots[r] = vecRoots[r];
+  return n;
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>> Recording of kinreco input >>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// Input of each SolveKinRecoDilepton() call (four momenta as X, Y, Z, E, MET) 
+// and the quartic equation parameters can be recorded to a binary file 
+// (see KinRecoRecordOpen()), to be used for benchmarks (see ttbarBench.cxx).
+struct ZKinRecoRecord
+{
+  double Lm[4], Lp[4], B[4], Bbar[4]; // lepton-, lepton+, b, bbar
+  double MetX, MetY; // MET
+  double Pars[5]; // quartic equation parameters (as used in SolveKinRecoDilepton())
+};
+
+// file for recording (NULL if not recording) and its lock (recording can be done from several threads)
+FILE* gKinRecoRecordFile = NULL;
+std::mutex gKinRecoRecordMutex;
+
+// start recording to provided file, returns false if it can not be opened
+bool KinRecoRecordOpen(const char* fileName)
+{
+  gKinRecoRecordFile = fopen(fileName, "wb");
+  if(!gKinRecoRecordFile)
+    printf("Error in KinRecoRecordOpen(): can not open %s\n", fileName);
+  return gKinRecoRecordFile != NULL;
+}
+
+// stop recording
+void KinRecoRecordClose()
+{
+  if(gKinRecoRecordFile)
+    fclose(gKinRecoRecordFile);
+  gKinRecoRecordFile = NULL;
+}
+
+// write one record
+void KinRecoRecordWrite(const ZFourVector& lm, const ZFourVector& lp, const ZFourVector& b, const ZFourVector& bbar, 
+                        const double metX, const double metY, const double* pars)
+{
+  ZKinRecoRecord rec;
+  const ZFourVector* vec[4] = { &lm, &lp, &b, &bbar };
+  double* out[4] = { rec.Lm, rec.Lp, rec.B, rec.Bbar };
+  for(int v = 0; v < 4; v++)
+  {
+    out[v][0] = vec[v]->Px;
+    out[v][1] = vec[v]->Py;
+    out[v][2] = vec[v]->Pz;
+    out[v][3] = vec[v]->E;
+  }
+  rec.MetX = metX;
+  rec.MetY = metY;
+  for(int p = 0; p < 5; p++)
+    rec.Pars[p] = pars[p];
+  std::lock_guard<std::mutex> lock(gKinRecoRecordMutex);
+  fwrite(&rec, sizeof(rec), 1, gKinRecoRecordFile);
+}
+
+// read all records from provided file
+std::vector<ZKinRecoRecord> KinRecoRecordRead(const char* fileName)
+{
+  std::vector<ZKinRecoRecord> vecRec;
+  FILE* f = fopen(fileName, "rb");
+  if(!f)
+  {
+    printf("Error in KinRecoRecordRead(): can not open %s\n", fileName);
+    exit(1);
+  }
+  ZKinRecoRecord rec;
+  while(fread(&rec, sizeof(rec), 1, f) == 1)
+    vecRec.push_back(rec);
+  fclose(f);
+  return vecRec;
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 // >>>>>>>>>>>>>>>>>>> ZSolutionKinRecoDilepton >>>>>>>>>>>>>>>>>>>>>>>>
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
@@ -31,7 +208,7 @@ struct ZSolutionKinRecoDilepton
   // (set weight to -1 by default)
   ZSolutionKinRecoDilepton(): zWeight(-1.0) {;}
   // top and antitop four momenta
-  TLorentzVector zT, zTbar;
+  ZFourVector zT, zTbar;
   // mumber of b-tagged jets (can be 0, 1 or 2)
   int zBTag;
   // weight of this solution
@@ -41,70 +218,51 @@ struct ZSolutionKinRecoDilepton
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-// >>>>>>>>>>>>>>>>> SolveKinRecoDilepton routine >>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>> ZKinRecoHalf >>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-// Routine to solve the kinreco problem for given b, bbar jets
-// Arguments:
-//    const TLorentzVector& lm:   lepton- momentum
-//    const TLorentzVector& lp:   lepton+ momentum
-//    const TLorentzVector& b:    b momentum
-//    const TLorentzVector& bbar: bbar momentum
-//    const double metX:          x-component of missing transverse energy (MET)
-//    const double metY:          y-component of missing transverse energy
-//    TH1D* hInacc = NULL:        histogram to be filled with the calculated inaccuracy (for debugging purpose, not filled by default)
-//    TH1D* ambiguity = NULL:     histogram to be filled with the number of ambiguities (for debugging purpose, not filled by default)
-// Returns the ZSolutionKinRecoDilepton pointer (see above)
-// For math, see Lars Sonnenschein's paper Phys.Rev. D73 (2006) 054015 [Erratum Phys.Rev. D73 (2006) 054015]
-ZSolutionKinRecoDilepton* SolveKinRecoDilepton(const TLorentzVector& lm, const TLorentzVector& lp, 
-  const TLorentzVector& b, const TLorentzVector& bbar, const double metX, const double metY, 
-  TH1D* hInacc = NULL, int* ambiguity = NULL)
+// Coefficients of one half of the event: top (b jet and lepton+) or 
+// antitop (bbar jet and lepton-). They depend on one jet only, so in 
+// KinRecoDilepton() they are calculated once per jet (see KinRecoPrepareHalf()), 
+// and only the combination of two halves is done for each jet pair 
+// (see SolveKinRecoDileptonPair()).
+// Notations follow Lars' paper: for top, K are a coefs and Q are c coefs, 
+// for antitop, K are b coefs, Q are d' coefs and D are d coefs (with MET).
+struct ZKinRecoHalf
+{
+  const ZFourVector* Lep; // lepton momentum
+  const ZFourVector* Jet; // jet momentum
+  double K1, K2, K3, K4;
+  double Q22, Q21, Q20, Q11, Q10, Q00;
+  double D22, D21, D20, D11, D10, D00;
+};
+
+// calculate coefficients for given lepton, jet and MET (metX, metY), see ZKinRecoHalf above 
+// (lepton and jet are not copied, they should exist while half is used)
+void KinRecoPrepareHalf(const ZFourVector& lep, const ZFourVector& jet, const double metX, const double metY, ZKinRecoHalf& half)
 {
   // constants
   const double massW = 80.4; // W boson mass
   const double massTop = 172.5; // top quark mass
-  double landauMean = 58.0; // mean of Landau distribution for neutrino momentum spectrum (see DESY-THESIS-2012-037)
-  double landauSigma = 22.0; // sigma of Landau distribution for neutrino momentum spectrum (see DESY-THESIS-2012-037)
-  double epsForCheck = 1e+0; // threshold for numerical precison checks (for debugging purpose)
   
   // Transform input into double variables with short names
-  // jet1 (b)
-  double xb = b.X();
-  double yb = b.Y();
-  double zb = b.Z();
-  double mb = b.M();
-  double mb2 = mb * mb;
-  double eb = b.E();
-  double eb2 = eb * eb;
-  // jet2 (bbar)
-  double xbbar = bbar.X();
-  double ybbar = bbar.Y();
-  double zbbar = bbar.Z();
-  double mbbar = bbar.M();
-  double mbbar2 = mbbar * mbbar;
-  double ebbar = bbar.E();
-  double ebbar2 = ebbar * ebbar;
-  // el (lm)
-  double xlm = lm.X();
-  double xlm2 = xlm * xlm;
-  double ylm = lm.Y();
-  double ylm2 = ylm * ylm;
-  double zlm = lm.Z();
-  double zlm2 = zlm * zlm;
-  double mlm = lm.M();
-  double mlm2 = mlm * mlm;
-  double elm = lm.E();
-  double elm2 = elm * elm;
-  // mu (lp)
-  double xlp = lp.X();
-  double xlp2 = xlp * xlp;
-  double ylp = lp.Y();
-  double ylp2 = ylp * ylp;
-  double zlp = lp.Z();
-  double zlp2 = zlp * zlp;
-  double mlp = lp.M();
-  double mlp2 = mlp * mlp;
-  double elp = lp.E();
-  double elp2 = elp * elp;
+  // jet
+  double xj = jet.Px;
+  double yj = jet.Py;
+  double zj = jet.Pz;
+  double mj = jet.M();
+  double mj2 = mj * mj;
+  double ej = jet.E;
+  // lepton
+  double xl = lep.Px;
+  double xl2 = xl * xl;
+  double yl = lep.Py;
+  double yl2 = yl * yl;
+  double zl = lep.Pz;
+  double zl2 = zl * zl;
+  double ml = lep.M();
+  double ml2 = ml * ml;
+  double el = lep.E;
+  double el2 = el * el;
   // MET
   double ex = metX;
   double ex2 = ex * ex;
@@ -116,45 +274,104 @@ ZSolutionKinRecoDilepton* SolveKinRecoDilepton(const TLorentzVector& lm, const T
   double mn2 = 0.0;
   
   // Calculate coefficients from Lars' paper
+  // a (top) or b (antitop) coefs
+  double k1 = (ej + el) * (mw2 - ml2 - mn2) - el * (mt2 - mj2 - ml2 - mn2) + 2 * ej * el2 - 2 * el * (xj * xl + yj * yl + zj * zl);
+  double k12 = k1 * k1;
+  double k2 = 2 * (ej * xl - el * xj);
+  double k22 = k2 * k2;
+  double k3 = 2 * (ej * yl - el * yj);
+  double k32 = k3 * k3;
+  double k4 = 2 * (ej * zl - el * zj);
+  double k42 = k4 * k4;
+  // c (top) or d' (antitop) coefs
+  double q22 = TMath::Power(mw2 - ml2 - mn2, 2.0) - 4 * (el2 - zl2) * k12 / k42 - 4 * (mw2 - ml2 - mn2) * zl * k1 / k4;
+  double q21 = 4 * (mw2 - ml2 - mn2) * (xl - zl * k2 / k4) - 8 * (el2 - zl2) * k1 * k2 / k42 - 8 * xl * zl * k1 / k4;
+  double q20 = -4 * (el2 - xl2) - 4 * (el2 - zl2) * k22 / k42 - 8 * xl * zl * k2 / k4;
+  double q11 = 4 * (mw2 - ml2 - mn2) * (yl - zl * k3 / k4) - 8 * (el2 - zl2) * k1 * k3 / k42 - 8 * yl * zl * k1 / k4;
+  double q10 = -8 * (el2 - zl2) * k2 * k3 / k42 + 8 * xl * yl - 8 * xl * zl * k3 / k4 - 8 * yl * zl * k2 / k4;
+  double q00 = -4 * (el2 - yl2) - 4 * (el2 - zl2) * k32 / k42 - 8 * yl * zl * k3 / k4;
+  
+  half.Lep = &lep;
+  half.Jet = &jet;
+  half.K1 = k1;
+  half.K2 = k2;
+  half.K3 = k3;
+  half.K4 = k4;
+  half.Q22 = q22;
+  half.Q21 = q21;
+  half.Q20 = q20;
+  half.Q11 = q11;
+  half.Q10 = q10;
+  half.Q00 = q00;
+  // d coefs (used for antitop only)
+  half.D22 = q22 + ex2 * q20 + ey2 * q00 + ex * ey * q10 + ex * q21 + ey * q11;
+  half.D21 = - q21 - 2 * ex * q20 - ey * q10;
+  half.D20 = q20;
+  half.D11 = - q11 - 2 * ey * q00 - ex * q10;
+  half.D10 = q10;
+  half.D00 = q00;
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>> SolveKinRecoDilepton routine >>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// Routine to solve the kinreco problem for given top and antitop halves 
+// (see ZKinRecoHalf above, prepared with the same MET)
+// Arguments:
+//    const ZKinRecoHalf& top:     top half (b jet and lepton+)
+//    const ZKinRecoHalf& antitop: antitop half (bbar jet and lepton-)
+//    const double metX:          x-component of missing transverse energy (MET)
+//    const double metY:          y-component of missing transverse energy
+//    ZSolutionKinRecoDilepton& solution: best solution (output, zT, zTbar and zWeight are set if solution is found)
+//    TH1D* hInacc = NULL:        histogram to be filled with the calculated inaccuracy (for debugging purpose, not filled by default)
+//    int* ambiguity = NULL:      counter of ambiguities (for debugging purpose, not incremented by default)
+//    const int landau:           method for neutrino weights (see EKinRecoLandau above)
+// Returns true if solution is found, false otherwise
+// For math, see Lars Sonnenschein's paper Phys.Rev. D73 (2006) 054015 [Erratum Phys.Rev. D73 (2006) 054015]
+bool SolveKinRecoDileptonPair(const ZKinRecoHalf& top, const ZKinRecoHalf& antitop, const double metX, const double metY, 
+  ZSolutionKinRecoDilepton& solution, TH1D* hInacc = NULL, int* ambiguity = NULL, const int landau = gKinRecoLandau)
+{
+  // constants
+  const double massW = 80.4; // W boson mass
+  const double massTop = 172.5; // top quark mass
+  double epsForCheck = 1e+0; // threshold for numerical precison checks (for debugging purpose)
+  
+  // input momenta
+  const ZFourVector& lp = *top.Lep;
+  const ZFourVector& b = *top.Jet;
+  const ZFourVector& lm = *antitop.Lep;
+  const ZFourVector& bbar = *antitop.Jet;
+  // MET
+  double ex = metX;
+  double ey = metY;
+  
+  // coefficients from Lars' paper (see KinRecoPrepareHalf())
   // a coefs
-  double a1 = (eb + elp) * (mw2 - mlp2 - mn2) - elp * (mt2 - mb2 - mlp2 - mn2) + 2 * eb * elp2 - 2 * elp * (xb * xlp + yb * ylp + zb * zlp);
-  double a12 = a1 * a1;
-  double a2 = 2 * (eb * xlp - elp * xb);
-  double a22 = a2 * a2;
-  double a3 = 2 * (eb * ylp - elp * yb);
-  double a32 = a3 * a3;
-  double a4 = 2 * (eb * zlp - elp * zb);
-  double a42 = a4 * a4;
+  double a1 = top.K1;
+  double a2 = top.K2;
+  double a3 = top.K3;
+  double a4 = top.K4;
   // b coefs
-  double b1 = (ebbar + elm) * (mw2 - mlm2 - mn2) - elm * (mt2 - mbbar2 - mlm2 - mn2) + 2 * ebbar * elm2 - 2 * elm * (xbbar * xlm + ybbar * ylm + zbbar * zlm);
-  double b12 = b1 * b1;
-  double b2 = 2 * (ebbar * xlm - elm * xbbar);
-  double b22 = b2 * b2;
-  double b3 = 2 * (ebbar * ylm - elm * ybbar);
-  double b32 = b3 * b3;
-  double b4 = 2 * (ebbar * zlm - elm * zbbar);
-  double b42 = b4 * b4;
+  double b1 = antitop.K1;
+  double b2 = antitop.K2;
+  double b3 = antitop.K3;
+  double b4 = antitop.K4;
   // c coefs
-  double c22 = TMath::Power(mw2 - mlp2 - mn2, 2.0) - 4 * (elp2 - zlp2) * a12 / a42 - 4 * (mw2 - mlp2 - mn2) * zlp * a1 / a4;
-  double c21 = 4 * (mw2 - mlp2 - mn2) * (xlp - zlp * a2 / a4) - 8 * (elp2 - zlp2) * a1 * a2 / a42 - 8 * xlp * zlp * a1 / a4;
-  double c20 = -4 * (elp2 - xlp2) - 4 * (elp2 - zlp2) * a22 / a42 - 8 * xlp * zlp * a2 / a4;
-  double c11 = 4 * (mw2 - mlp2 - mn2) * (ylp - zlp * a3 / a4) - 8 * (elp2 - zlp2) * a1 * a3 / a42 - 8 * ylp * zlp * a1 / a4;
-  double c10 = -8 * (elp2 - zlp2) * a2 * a3 / a42 + 8 * xlp * ylp - 8 * xlp * zlp * a3 / a4 - 8 * ylp * zlp * a2 / a4;
-  double c00 = -4 * (elp2 - ylp2) - 4 * (elp2 - zlp2) * a32 / a42 - 8 * ylp * zlp * a3 / a4;
-  // d' coefs
-  double d22p = TMath::Power(mw2 - mlm2 - mn2, 2.0) - 4 * (elm2 - zlm2) * b12 / b42 - 4 * (mw2 - mlm2 - mn2) * zlm * b1 / b4;
-  double d21p = 4 * (mw2 - mlm2 - mn2) * (xlm - zlm * b2 / b4) - 8 * (elm2 - zlm2) * b1 * b2 / b42 - 8 * xlm * zlm * b1 / b4;
-  double d20p = -4 * (elm2 - xlm2) - 4 * (elm2 - zlm2) * b22 / b42 - 8 * xlm* zlm * b2 / b4;
-  double d11p = 4 * (mw2 - mlm2 - mn2) * (ylm - zlm * b3 / b4) - 8 * (elm2 - zlm2) * b1 * b3 / b42 - 8 * ylm * zlm * b1 / b4;
-  double d10p = -8 * (elm2 - zlm2) * b2 * b3 / b42 + 8 * xlm * ylm - 8 * xlm * zlm * b3 / b4 - 8 * ylm * zlm * b2 / b4;
-  double d00p = -4 * (elm2 - ylm2) - 4 * (elm2 - zlm2) * b32 / b42 - 8 * ylm * zlm * b3 / b4;
+  double c22 = top.Q22;
+  double c21 = top.Q21;
+  double c20 = top.Q20;
+  double c11 = top.Q11;
+  double c10 = top.Q10;
+  double c00 = top.Q00;
   // d coefs
-  double d22 = d22p + ex2 * d20p + ey2 * d00p + ex * ey * d10p + ex * d21p + ey * d11p;
-  double d21 = - d21p - 2 * ex * d20p - ey * d10p;
-  double d20 = d20p;
-  double d11 = - d11p - 2 * ey * d00p - ex * d10p;
-  double d10 = d10p;
-  double d00 = d00p;
+  double d22 = antitop.D22;
+  double d21 = antitop.D21;
+  double d20 = antitop.D20;
+  double d11 = antitop.D11;
+  double d10 = antitop.D10;
+  double d00 = antitop.D00;
+
   // h coefs
   double h4 = c00 * c00 * d22 * d22 + c11 * d22 * (c11 * d00 - c00 * d11) 
             + c00 * c22 * (d11 * d11 - 2 * d00 * d22) + c22 * d00 * (c22 * d00 - c11 * d11);
@@ -177,7 +394,6 @@ ZSolutionKinRecoDilepton* SolveKinRecoDilepton(const TLorentzVector& lm, const T
             + c20 * d10 * (c00 * d10 - c10 * d00) + c20 * d00 * (c20 * d00 - 2 * c00 * d20);
   
   // solve quartic equation
-  ROOT::Math::Polynomial eq(4);
   double pars[5] = { h4, h3, h2, h1, h0 };
   // apply globale scaling to avoid possible numerical precision problems
   double minpar = 1e100;
@@ -187,15 +403,17 @@ ZSolutionKinRecoDilepton* SolveKinRecoDilepton(const TLorentzVector& lm, const T
   for(int p = 0; p < 5; p++)
     pars[p] /= minpar;
   //printf("parameters: %e %e %e %e %e\n", pars[0], pars[1], pars[2], pars[3], pars[4]);
-  eq.SetParameters(pars);
-  std::vector<double> roots = eq.FindRealRoots();
+  if(gKinRecoRecordFile)
+    KinRecoRecordWrite(lm, lp, b, bbar, metX, metY, pars);
+  double roots[4];
+  const int nRoots = KinRecoQuarticRoots(pars, roots);
   if(gDebug)
-    printf("N roots: %ld\n", roots.size());
+    printf("N roots: %d\n", nRoots);
   
   // restore all nu and nubar momenta components (see again Lars' paper)
-  TLorentzVector nu, nubar, nuBest, nubarBest;
+  ZFourVector nuBest, nubarBest;
   double weightBest = -1.0;
-  for(int s = 0; s < roots.size(); s++)
+  for(int s = 0; s < nRoots; s++)
   {
     // check main equation
     double sol = pars[0] + pars[1]*roots[s] + pars[2]*roots[s]*roots[s] + pars[3]*roots[s]*roots[s]*roots[s] + pars[4]*roots[s]*roots[s]*roots[s]*roots[s];
@@ -223,25 +441,25 @@ ZSolutionKinRecoDilepton* SolveKinRecoDilepton(const TLorentzVector& lm, const T
       //exit(1);
       continue;
     }
-    TLorentzVector nu, nubar;
+    ZFourVector nu, nubar;
     nu.SetXYZM(xn, yn, zn, 0.0);
     nubar.SetXYZM(xnbar, ynbar, znbar, 0.0);
     // check solution
-    TLorentzVector wp = lp + nu;
-    TLorentzVector wm = lm + nubar;
-    TLorentzVector t = wp + b;
-    TLorentzVector tbar = wm + bbar;
+    ZFourVector wp = lp + nu;
+    ZFourVector wm = lm + nubar;
+    ZFourVector t = wp + b;
+    ZFourVector tbar = wm + bbar;
     if(gDebug)
-      printf("%e %e %e %e %e %e\n", wp.M(), wm.M(), t.M(), tbar.M(), nu.X() + nubar.X() - ex, nu.Y() + nubar.Y() - ey);
+      printf("%e %e %e %e %e %e\n", wp.M(), wm.M(), t.M(), tbar.M(), nu.Px + nubar.Px - ex, nu.Py + nubar.Py - ey);
     // below are some calculations done for debugging purpose
     double inaccuracy = TMath::Abs(wp.M() - massW) + TMath::Abs(wm.M() - massW)
                       + TMath::Abs(t.M() - massTop) + TMath::Abs(tbar.M() - massTop) 
-                      + TMath::Abs((nu + nubar).X() - ex) + TMath::Abs((nu + nubar).Y() - ey);
+                      + TMath::Abs((nu + nubar).Px - ex) + TMath::Abs((nu + nubar).Py - ey);
     if(hInacc)
       hInacc->Fill(inaccuracy);
     if(inaccuracy > epsForCheck )
     {
-      //printf("%e %e %e %e %e %e\n", wp.M(), wm.M(), t.M(), tbar.M(), nu.X() + nubar.X() - ex, nu.Y() + nubar.Y() - ey);
+      //printf("%e %e %e %e %e %e\n", wp.M(), wm.M(), t.M(), tbar.M(), nu.Px + nubar.Px - ex, nu.Py + nubar.Py - ey);
       //printf("SolveKinRecoDilepton: inaccuracy %f > %e\n", inaccuracy, epsForCheck);
       //exit(1);
       //continue;
@@ -252,11 +470,11 @@ ZSolutionKinRecoDilepton* SolveKinRecoDilepton(const TLorentzVector& lm, const T
         printf("inaccuracy: %f\n", inaccuracy);
     }
     // calculate weight according to nu and nubar momenta (see DESY-THESIS-2012-037)
-    double wnu = TMath::Landau(nu.E(), landauMean, landauSigma);
-    double wnubar = TMath::Landau(nubar.E(), landauMean, landauSigma);
+    double wnu = KinRecoLandauWeight(nu.E, landau);
+    double wnubar = KinRecoLandauWeight(nubar.E, landau);
     double weight = wnu * wnubar;
     if(gDebug)
-      printf("nu e: %f %f  weight: %f\n", nu.E(), nubar.E(), weight);
+      printf("nu e: %f %f  weight: %f\n", nu.E, nubar.E, weight);
     // update solution, if this is the best weight
     if(weight > weightBest)
     {
@@ -271,14 +489,146 @@ ZSolutionKinRecoDilepton* SolveKinRecoDilepton(const TLorentzVector& lm, const T
   
   // if the best weight is default negative, there is no solution
   if(weightBest < 0.0)
-    return NULL;
+    return false;
   
-  // store and return best solution as ZSolutionKinRecoDilepton instance
-  ZSolutionKinRecoDilepton* solution = new ZSolutionKinRecoDilepton;
-  solution->zT = (nuBest + lp + b);
-  solution->zTbar = (nubarBest + lm + bbar);
-  solution->zWeight = weightBest;
-  return solution;
+  // store best solution
+  solution.zT = (nuBest + lp + b);
+  solution.zTbar = (nubarBest + lm + bbar);
+  solution.zWeight = weightBest;
+  return true;
+}
+
+// Routine to solve the kinreco problem for given b, bbar jets
+// Arguments:
+//    const ZFourVector& lm:      lepton- momentum
+//    const ZFourVector& lp:      lepton+ momentum
+//    const ZFourVector& b:       b momentum
+//    const ZFourVector& bbar:    bbar momentum
+//    other arguments and returned value: see SolveKinRecoDileptonPair() above
+bool SolveKinRecoDilepton(const ZFourVector& lm, const ZFourVector& lp, 
+  const ZFourVector& b, const ZFourVector& bbar, const double metX, const double metY, 
+  ZSolutionKinRecoDilepton& solution, TH1D* hInacc = NULL, int* ambiguity = NULL, const int landau = gKinRecoLandau)
+{
+  ZKinRecoHalf top, antitop;
+  KinRecoPrepareHalf(lp, b, metX, metY, top);
+  KinRecoPrepareHalf(lm, bbar, metX, metY, antitop);
+  return SolveKinRecoDileptonPair(top, antitop, metX, metY, solution, hInacc, ambiguity, landau);
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>> Pruned jet pair loop >>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// pruning counters (gKinRecoPrune): numbers of events, of jet pairs 
+// and of jet pairs which were not solved
+std::atomic<long> gKinRecoPruneNEvents(0);
+std::atomic<long> gKinRecoPruneNPairs(0);
+std::atomic<long> gKinRecoPruneNSkipped(0);
+
+// print pruning counters (differences with respect to provided values)
+void KinRecoPrunePrint(const long nEvents0 = 0, const long nPairs0 = 0, const long nSkipped0 = 0)
+{
+  const long nEvents = gKinRecoPruneNEvents - nEvents0;
+  const long nPairs = gKinRecoPruneNPairs - nPairs0;
+  const long nSkipped = gKinRecoPruneNSkipped - nSkipped0;
+  printf("kinreco pruning: %ld events, %ld jet pairs, %ld not solved (%.2f per event, %.1f%%)\n", nEvents, nPairs, nSkipped,
+    (nEvents > 0) ? (1.0 * nSkipped / nEvents) : 0.0, (nPairs > 0) ? (100.0 * nSkipped / nPairs) : 0.0);
+}
+
+// Jet pair loop of KinRecoDilepton() (see there for arguments, jetBTag, top and antitop 
+// are prepared per jet) which gives the same solution as the exhaustive loop 
+// with fewer SolveKinRecoDileptonPair() calls.
+// The exhaustive loop takes the first solution with the largest number of b-tagged 
+// jets C found in (j1, j2) order, and replaces it by a later solution of the same 
+// class only if its weight is larger than the best weight so far, which also includes 
+// solutions of lower classes found before the first one of class C (the weight is 
+// not reset when the class improves). Therefore:
+//   1) pairs are solved class by class (2, 1, 0) in (j1, j2) order, lower classes 
+//      are skipped once a class has a solution;
+//   2) lower class pairs after the first solution of class C never matter;
+//   3) lower class pairs before it are solved only if there are more solutions of 
+//      class C, to obtain the best weight at that point.
+// Debugging histograms (hInacc, hAmbig) are filled only for solved pairs.
+int KinRecoDileptonPruned(const int nJets, const int* jetBTag, const ZKinRecoHalf* top, const ZKinRecoHalf* antitop, 
+  const double metX, const double metY, ZFourVector& t, ZFourVector& tbar, TH1D* hInacc, TH1D* hAmbig, const int landau)
+{
+  int ambiguity = 0;
+  int nCalls = 0;
+  // class with solution, index (in (j1, j2) order) and first solution of this class, 
+  // and first solution with the largest weight among the later ones of this class
+  int bTagClass = -1;
+  int pairFirst = -1;
+  ZSolutionKinRecoDilepton solFirst, solLater;
+  for(int c = 2; c >= 0 && bTagClass < 0; c--)
+  {
+    int pair = -1;
+    for(int j1 = 0; j1 < nJets; j1++)
+      for(int j2 = 0; j2 < nJets; j2++)
+      {
+        if(j1 == j2) continue;
+        pair++;
+        if(jetBTag[j1] + jetBTag[j2] != c) continue;
+        ZSolutionKinRecoDilepton sol;
+        nCalls++;
+        if(!SolveKinRecoDileptonPair(top[j1], antitop[j2], metX, metY, sol, hInacc, hAmbig ? &ambiguity : NULL, landau) || sol.zWeight < 0)
+          continue;
+        if(pairFirst < 0)
+        {
+          pairFirst = pair;
+          solFirst = sol;
+        }
+        else if(sol.zWeight > solLater.zWeight)
+          solLater = sol;
+      }
+    if(pairFirst >= 0)
+      bTagClass = c;
+  }
+  // best weight at the first solution of class C: solutions of lower classes before it, 
+  // selected as in KinRecoDilepton() (for C = 0 there are none, the best weight is 0)
+  double weightBest = 0.0;
+  if(bTagClass > 0 && solLater.zWeight >= 0.0)
+  {
+    int bTagBest = 0;
+    int pair = -1;
+    for(int j1 = 0; j1 < nJets; j1++)
+      for(int j2 = 0; j2 < nJets; j2++)
+      {
+        if(j1 == j2) continue;
+        pair++;
+        const int bTagThis = jetBTag[j1] + jetBTag[j2];
+        // (pairs of class C or higher before the first solution have no solution)
+        if(pair >= pairFirst || bTagThis >= bTagClass || bTagThis < bTagBest) continue;
+        ZSolutionKinRecoDilepton sol;
+        nCalls++;
+        if(!SolveKinRecoDileptonPair(top[j1], antitop[j2], metX, metY, sol, hInacc, hAmbig ? &ambiguity : NULL, landau) || sol.zWeight < 0)
+          continue;
+        if(bTagThis > bTagBest)
+          bTagBest = bTagThis;
+        else if(sol.zWeight > weightBest)
+          weightBest = sol.zWeight;
+      }
+  }
+  // for C = 0 the first solution is compared to the best weight as the later ones
+  int solved = 0;
+  if(bTagClass > 0 || (bTagClass == 0 && solFirst.zWeight > weightBest))
+  {
+    t = solFirst.zT;
+    tbar = solFirst.zTbar;
+    weightBest = TMath::Max(weightBest, (bTagClass == 0) ? solFirst.zWeight : 0.0);
+    solved = 1;
+  }
+  if(bTagClass >= 0 && solLater.zWeight > weightBest)
+  {
+    t = solLater.zT;
+    tbar = solLater.zTbar;
+    solved = 1;
+  }
+  if(solved && hAmbig)
+    hAmbig->Fill(ambiguity);
+  gKinRecoPruneNEvents++;
+  gKinRecoPruneNPairs += nJets * (nJets - 1);
+  gKinRecoPruneNSkipped += nJets * (nJets - 1) - nCalls;
+  return solved;
 }
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 
@@ -287,20 +637,41 @@ ZSolutionKinRecoDilepton* SolveKinRecoDilepton(const TLorentzVector& lm, const T
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 // Routine to solve the kinreco problem for the whole event (possibly with more than 2 jets)
 // Arguments:
-//    const TLorentzVector& lm:   lepton- momentum
-//    const TLorentzVector& lp:   lepton+ momentum
-//    const std::vector<TLorentzVector>& jets: container with jet momenta
+//    const ZFourVector& lm:      lepton- momentum
+//    const ZFourVector& lp:      lepton+ momentum
+//    const ZJet* jets:           array with jets (momenta and b-tagging flags, see fourVector.h)
+//    const int nJets:            number of jets
 //    const double metX:          x-component of missing transverse energy (MET)
 //    const double metY:          y-component of missing transverse energy
-//    const TLorentzVector& t:    top momentum (output)
-//    const TLorentzVector& tbar: top momentum (output)
+//    ZFourVector& t:             top momentum (output)
+//    ZFourVector& tbar:          top momentum (output)
 //    TH1D* hInacc = NULL:        histogram to be filled with the calculated inaccuracy (for debugging purpose, not filled by default, see there usage in SolveKinRecoDilepton())
 //    TH1D* ambiguity = NULL:     histogram to be filled with the number of ambiguities (for debugging purpose, not filled by default, see there usage in SolveKinRecoDilepton())
+//    const int landau:           method for neutrino weights (see EKinRecoLandau above)
 // Returns 1 for successfull kinreco, 0 otherwise
+// No memory is allocated on heap: solutions are returned by value and the best one 
+// is chosen on the fly, in the same order as they are obtained.
+// Coefficients which depend on one jet only are calculated once per jet (see ZKinRecoHalf).
 // 
-int KinRecoDilepton(const TLorentzVector& lm, const TLorentzVector& mp, const std::vector<TLorentzVector>& jets, 
-  const double metX, const double metY, TLorentzVector& t, TLorentzVector& tbar, TH1D* hInacc = NULL, TH1D* hAmbig = NULL)
+int KinRecoDilepton(const ZFourVector& lm, const ZFourVector& mp, const ZJet* jets, const int nJets, 
+  const double metX, const double metY, ZFourVector& t, ZFourVector& tbar, TH1D* hInacc = NULL, TH1D* hAmbig = NULL, 
+  const int landau = gKinRecoLandau)
 {
+  // validation of tabulated neutrino weights: solve with both, return the exact result
+  // (with recording of kinreco input, each jet pair is recorded twice)
+  if(landau == kLandauValidate)
+  {
+    ZFourVector tTable, tbarTable;
+    const int solvedTable = KinRecoDilepton(lm, mp, jets, nJets, metX, metY, tTable, tbarTable, NULL, NULL, kLandauTable);
+    const int solvedExact = KinRecoDilepton(lm, mp, jets, nJets, metX, metY, t, tbar, hInacc, hAmbig, kLandauExact);
+    if(solvedExact || solvedTable)
+    {
+      gKinRecoLandauNEvents++;
+      if(solvedExact != solvedTable || t != tTable || tbar != tbarTable)
+        gKinRecoLandauNDiffer++;
+    }
+    return solvedExact;
+  }
   // solution status (to be returned)
   int solved = 0;
   // best number of b-tagged jets (maximum 2)
@@ -308,116 +679,105 @@ int KinRecoDilepton(const TLorentzVector& lm, const TLorentzVector& mp, const st
   // best (largest) solution weight
   double weightBest = 0.0;
   
-  // container with solutions
-  std::vector<ZSolutionKinRecoDilepton*> vSolutions;
-  // ambiguity and hAmbig pointers are for debugging purpose, not used normally
-  int* ambiguity = NULL;
-  if(hAmbig)
-    ambiguity = new int(0);
+  // ambiguity counter is for debugging purpose, used only with hAmbig
+  int ambiguity = 0;
     
   // print the number of jets if needed
   if(gDebug)
-    printf("N jets: %ld\n", jets.size());
+    printf("N jets: %d\n", nJets);
+  
+  // per jet stage: for each jet, take b-tagging flag and prepare kinreco 
+  // coefficients for this jet as b (with lepton+) and as bbar (with lepton-)
+  if(nJets > kinRecoMaxNJets)
+  {
+    printf("Error in KinRecoDilepton(): %d jets > kinRecoMaxNJets = %d\n", nJets, kinRecoMaxNJets);
+    exit(1);
+  }
+  int jetBTag[kinRecoMaxNJets];
+  ZKinRecoHalf top[kinRecoMaxNJets], antitop[kinRecoMaxNJets];
+  for(int j = 0; j < nJets; j++)
+  {
+    jetBTag[j] = jets[j].BTag ? 1 : 0;
+    KinRecoPrepareHalf(mp, jets[j].P, metX, metY, top[j]);
+    KinRecoPrepareHalf(lm, jets[j].P, metX, metY, antitop[j]);
+  }
+  
+  // pruned jet pair loop, gives the same solution (see above)
+  if(gKinRecoPrune)
+    return KinRecoDileptonPruned(nJets, jetBTag, top, antitop, metX, metY, t, tbar, hInacc, hAmbig, landau);
   
   // loop over 1st jet
-  for(std::vector<TLorentzVector>::const_iterator jet1 = jets.begin(); jet1 != jets.end(); jet1++)
+  for(int j1 = 0; j1 < nJets; j1++)
   {
-    // skip if already have solution(s) with two b-tagged jets
-    //if(jet1->pt() > 0 && bTagBest > 0)
-    //  continue;
     // loop over 2nd jet
-    for(std::vector<TLorentzVector>::const_iterator jet2 = jets.begin(); jet2 != jets.end(); jet2++)
+    for(int j2 = 0; j2 < nJets; j2++)
     {
       // skip same jets
-      if(jet1 == jet2) continue;
-      // for this pair of jets, calculate number of b-tagged jets,
-      // b-tagged jets are provided with negative masses (see selection.h):
-      // account for this, then switch their masses to normal
-      int bTagThis = 0;
-      TLorentzVector jetB, jetBbar;
-      if(jet1->M() < 0)
-      {
-        TLorentzVector jet;
-        jet.SetPtEtaPhiM(jet1->Pt(), jet1->Eta(), jet1->Phi(), -1 * jet1->M());
-        jetB = jet;
-        bTagThis++;
-      }
-      else
-        jetB = *jet1;
-      if(jet2->M() < 0)
-      {
-        TLorentzVector jet;
-        jet.SetPtEtaPhiM(jet2->Pt(), jet2->Eta(), jet2->Phi(), -1 * jet2->M());
-        jetBbar = jet;
-        bTagThis++;
-      }
-      else
-        jetBbar = *jet2;
+      if(j1 == j2) continue;
+      // for this pair of jets, number of b-tagged jets
+      int bTagThis = jetBTag[j1] + jetBTag[j2];
       // get solution
-      TLorentzVector tThis, tbarThis;
-      ZSolutionKinRecoDilepton* solution = SolveKinRecoDilepton(lm, mp, jetB, jetBbar, metX, metY, hInacc, ambiguity);
-      if(!solution || solution->zWeight < 0)
+      ZSolutionKinRecoDilepton sol;
+      if(!SolveKinRecoDileptonPair(top[j1], antitop[j2], metX, metY, sol, hInacc, hAmbig ? &ambiguity : NULL, landau) || sol.zWeight < 0)
         continue;
       // set b-tagging number
-      solution->zBTag = bTagThis;
-      // push to the container
-      vSolutions.push_back(solution);
-    }
-  }
-  
-  // find best solution, preference order:
-  //   with 2 b-tagged jets, if no then
-  //   with 1 b-tagged jet, if no then
-  //   with 0 b-tagged jets.
-  // If more than one solution with the same number of b-tagged jets 
-  // is available, take the solution with the largest weight 
-  // (calculated according to the neutrino momenta spectrum, 
-  // see DESY-THESIS-20120-037)
-  for(std::vector<ZSolutionKinRecoDilepton*>::iterator it = vSolutions.begin(); it != vSolutions.end(); it++)
-  {
-    ZSolutionKinRecoDilepton* sol = *it;
-    // worse b-tagging
-    if(sol->zBTag < bTagBest)
-      continue;
-    // better b-tagging
-    else if(sol->zBTag > bTagBest)
-    {
-      bTagBest = sol->zBTag;
-      t = sol->zT;
-      tbar = sol->zTbar;
-      solved = 1;
-    }
-    // same b-tagging: check weight
-    else
-    {
-      if(sol->zWeight > weightBest)
+      sol.zBTag = bTagThis;
+      
+      // update best solution, preference order:
+      //   with 2 b-tagged jets, if no then
+      //   with 1 b-tagged jet, if no then
+      //   with 0 b-tagged jets.
+      // If more than one solution with the same number of b-tagged jets 
+      // is available, take the solution with the largest weight 
+      // (calculated according to the neutrino momenta spectrum, 
+      // see DESY-THESIS-20120-037)
+      // worse b-tagging
+      if(sol.zBTag < bTagBest)
+        continue;
+      // better b-tagging
+      else if(sol.zBTag > bTagBest)
       {
-        weightBest = sol->zWeight;
-        t = sol->zT;
-        tbar = sol->zTbar;
+        bTagBest = sol.zBTag;
+        t = sol.zT;
+        tbar = sol.zTbar;
         solved = 1;
       }
+      // same b-tagging: check weight
+      else
+      {
+        if(sol.zWeight > weightBest)
+        {
+          weightBest = sol.zWeight;
+          t = sol.zT;
+          tbar = sol.zTbar;
+          solved = 1;
+        }
+      }
     }
   }
+  // for debugging purpose, if needed
   if(solved && hAmbig)
-  {
-    // for debugging purpose, if needed
-    hAmbig->Fill(*ambiguity);
-    delete ambiguity;
-  }
+    hAmbig->Fill(ambiguity);
   
-  // all done, clear memory and return
-  for(std::vector<ZSolutionKinRecoDilepton*>::iterator it = vSolutions.begin(); it != vSolutions.end(); it++)
-    delete (*it);
   return solved;
 }
+
+// same as above, with jets in std::vector
+int KinRecoDilepton(const ZFourVector& lm, const ZFourVector& mp, const std::vector<ZJet>& jets, 
+  const double metX, const double metY, ZFourVector& t, ZFourVector& tbar, TH1D* hInacc = NULL, TH1D* hAmbig = NULL, 
+  const int landau = gKinRecoLandau)
+{
+  return KinRecoDilepton(lm, mp, jets.data(), jets.size(), metX, metY, t, tbar, hInacc, hAmbig, landau);
+}
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 
 
 // routines below are not used in the analysis, 
-// available for debugging purpose
+// available for debugging purpose and for synthetic events (see synthEvent.h)
 
-// to generate decay a -> b, c
+// to generate decay a -> b, c 
+// (r1, r2 are random numbers uniform in [0, 1]: isotropic decay in the rest frame of a, 
+// used for synthetic events, see synthEvent.h)
 void Decay(const TLorentzVector& a, const double mb, const double mc, const double r1, const double r2, 
            TLorentzVector& b, TLorentzVector& c)
 {
@@ -428,12 +788,16 @@ void Decay(const TLorentzVector& a, const double mb, const double mc, const doub
   double num = TMath::Power(ma2 - mb2 - mc2, 2.0) - 4 * mb2 * mc2;
   double denom = 4 * ma2;
   double p = TMath::Sqrt(num / denom);
-  printf("p = %f\n", p);
-  printf("sqrt(p2 + mb2) + sqrt(p2 + mc2) = a.E(): %f + %f = %f\n", TMath::Sqrt(p * p + mb2), TMath::Sqrt(p * p + mc2), a.M());
-  double theta = TMath::Pi() * r1;
+  if(gDebug)
+  {
+    printf("p = %f\n", p);
+    printf("sqrt(p2 + mb2) + sqrt(p2 + mc2) = a.E(): %f + %f = %f\n", TMath::Sqrt(p * p + mb2), TMath::Sqrt(p * p + mc2), a.M());
+  }
+  double cosTheta = 2 * r1 - 1;
+  double sinTheta = TMath::Sqrt(1 - cosTheta * cosTheta);
   double phi = 2 * TMath::Pi() * r2;
-  b.SetXYZM(p * TMath::Cos(theta) * TMath::Cos(phi), p * TMath::Cos(theta) * TMath::Sin(phi), p * TMath::Sin(theta), mb);
-  c.SetXYZM(- p * TMath::Cos(theta) * TMath::Cos(phi), - p * TMath::Cos(theta) * TMath::Sin(phi), - p * TMath::Sin(theta), mc);
+  b.SetXYZM(p * sinTheta * TMath::Cos(phi), p * sinTheta * TMath::Sin(phi), p * cosTheta, mb);
+  c.SetXYZM(- p * sinTheta * TMath::Cos(phi), - p * sinTheta * TMath::Sin(phi), - p * cosTheta, mc);
   //b = b + a;
   //c = c + a;
   TVector3 boost = a.BoostVector();
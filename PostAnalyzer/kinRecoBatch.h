@@ -0,0 +1,369 @@
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>> Batched kinematic reconstruction (kinreco) >>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// The same kinematic reconstruction as KinRecoDilepton() (see kinReco.h)
+// for many events at once: jet pair hypotheses of all queued events are
+// stored as structure of arrays (one array per coefficient), and the
+// arithmetic stages (quartic equation coefficients, neutrino momenta,
+// inaccuracy) run as simple loops over all hypotheses, which the compiler
+// vectorises (SSE2 by default, AVX2/AVX-512 with -march=native, see
+// compile.sh). Quartic roots and Landau weights are calculated per
+// hypothesis with the same routines as in kinReco.h, and the best
+// solution is selected in the same order, so the results are identical
+// to KinRecoDilepton() (which is the scalar fallback).
+// Debugging printouts (gDebug), validation of tabulated neutrino weights
+// (kLandauValidate, with it exact weights are used here) and pruning of
+// jet pairs (gKinRecoPrune) are available in KinRecoDilepton() only.
+
+#ifndef TTBAR_KINRECOBATCH_H
+#define TTBAR_KINRECOBATCH_H
+
+// additional files from this analysis
+#include "kinReco.h"
+// C++ library or ROOT header files
+#include <vector>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>> ZKinRecoBatch >>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// Typical usage:
+//   ZKinRecoBatch batch;
+//   int ev = batch.AddEvent(lm, lp, jets, nJets, metX, metY); // for many events
+//   batch.Solve();
+//   if(batch.Status(ev)) { batch.T(ev) ... batch.Tbar(ev) ... }
+//   batch.Clear(); // memory is kept for the next block
+//
+class ZKinRecoBatch
+{
+  public:
+    // constructor
+    ZKinRecoBatch() { Clear(); }
+
+    // remove all events (allocated memory is kept)
+    void Clear()
+    {
+      for(int c = 0; c < kNColumns; c++)
+        zCol[c].clear();
+      zHypEvent.clear();
+      zHypBTag.clear();
+      zEvFirstHyp.clear();
+      zEvStatus.clear();
+      zEvT.clear();
+      zEvTbar.clear();
+      zNHyp = 0;
+    }
+
+    // add event (arguments as for KinRecoDilepton()), returns its index in the batch
+    int AddEvent(const ZFourVector& lm, const ZFourVector& lp, const ZJet* jets, const int nJets,
+                 const double metX, const double metY)
+    {
+      const int ev = zEvFirstHyp.size();
+      zEvFirstHyp.push_back(zNHyp);
+      // per jet stage: as in KinRecoDilepton()
+      if(nJets > kinRecoMaxNJets)
+      {
+        printf("Error in ZKinRecoBatch::AddEvent(): %d jets > kinRecoMaxNJets = %d\n", nJets, kinRecoMaxNJets);
+        exit(1);
+      }
+      int jetBTag[kinRecoMaxNJets];
+      ZKinRecoHalf top[kinRecoMaxNJets], antitop[kinRecoMaxNJets];
+      for(int j = 0; j < nJets; j++)
+      {
+        jetBTag[j] = jets[j].BTag ? 1 : 0;
+        KinRecoPrepareHalf(lp, jets[j].P, metX, metY, top[j]);
+        KinRecoPrepareHalf(lm, jets[j].P, metX, metY, antitop[j]);
+      }
+      // jet pair hypotheses in the same order as in KinRecoDilepton()
+      for(int j1 = 0; j1 < nJets; j1++)
+        for(int j2 = 0; j2 < nJets; j2++)
+        {
+          if(j1 == j2) continue;
+          AddHypothesis(top[j1], antitop[j2], metX, metY);
+          zHypEvent.push_back(ev);
+          zHypBTag.push_back(jetBTag[j1] + jetBTag[j2]);
+        }
+      return ev;
+    }
+
+    // number of events in the batch
+    int NEvents() const { return zEvFirstHyp.size(); }
+
+    // number of jet pair hypotheses in the batch
+    int NHypotheses() const { return zNHyp; }
+
+    // solve all events (hInacc, hAmbig: see KinRecoDilepton())
+    void Solve(TH1D* hInacc = NULL, TH1D* hAmbig = NULL)
+    {
+      const int n = zNHyp;
+      const int nEv = zEvFirstHyp.size();
+      for(int c = kP0; c < kNColumns; c++)
+        zCol[c].resize((c >= kNuX) ? (4 * n) : n);
+      zHypNRoots.resize(n);
+      // quartic equation parameters (vectorised)
+      SolveCoefficients(n);
+      // quartic roots (per hypothesis)
+      double* root = Col(kRoot);
+      for(int i = 0; i < n; i++)
+      {
+        double pars[5] = { Col(kP0)[i], Col(kP1)[i], Col(kP2)[i], Col(kP3)[i], Col(kP4)[i] };
+        if(gKinRecoRecordFile)
+          KinRecoRecordWrite(Vector(kLmX, i), Vector(kLpX, i), Vector(kBX, i), Vector(kBbarX, i), Col(kEx)[i], Col(kEy)[i], pars);
+        double roots[4] = { 0.0, 0.0, 0.0, 0.0 };
+        zHypNRoots[i] = KinRecoQuarticRoots(pars, roots);
+        for(int r = 0; r < 4; r++)
+          root[r * n + i] = roots[r];
+      }
+      // neutrino momenta and inaccuracy for each root (vectorised)
+      SolveNeutrinos(n);
+      // best solution for each hypothesis and for each event (in the same order as in KinRecoDilepton())
+      zEvStatus.assign(nEv, 0);
+      zEvT.resize(nEv);
+      zEvTbar.resize(nEv);
+      for(int ev = 0; ev < nEv; ev++)
+      {
+        const int hypEnd = (ev + 1 < nEv) ? zEvFirstHyp[ev + 1] : n;
+        int bTagBest = 0;
+        double weightBest = 0.0;
+        int ambiguity = 0;
+        for(int i = zEvFirstHyp[ev]; i < hypEnd; i++)
+        {
+          ZSolutionKinRecoDilepton sol;
+          if(!SelectRoot(i, n, sol, hInacc, hAmbig ? &ambiguity : NULL) || sol.zWeight < 0)
+            continue;
+          sol.zBTag = zHypBTag[i];
+          // worse b-tagging
+          if(sol.zBTag < bTagBest)
+            continue;
+          // better b-tagging
+          else if(sol.zBTag > bTagBest)
+          {
+            bTagBest = sol.zBTag;
+            zEvT[ev] = sol.zT;
+            zEvTbar[ev] = sol.zTbar;
+            zEvStatus[ev] = 1;
+          }
+          // same b-tagging: check weight
+          else
+          {
+            if(sol.zWeight > weightBest)
+            {
+              weightBest = sol.zWeight;
+              zEvT[ev] = sol.zT;
+              zEvTbar[ev] = sol.zTbar;
+              zEvStatus[ev] = 1;
+            }
+          }
+        }
+        if(zEvStatus[ev] && hAmbig)
+          hAmbig->Fill(ambiguity);
+      }
+    }
+
+    // status of provided event after Solve(): 1 for successfull kinreco, 0 otherwise
+    int Status(const int ev) const { return zEvStatus[ev]; }
+
+    // top and antitop momenta of provided event after Solve() (if Status(ev) = 1)
+    const ZFourVector& T(const int ev) const { return zEvT[ev]; }
+    const ZFourVector& Tbar(const int ev) const { return zEvTbar[ev]; }
+
+  private:
+    // columns: one value per hypothesis (up to kNuX), or per hypothesis and root (from kNuX, 4 roots)
+    enum EColumn
+    {
+      kEx, kEy,
+      kA1, kA2, kA3, kA4, kB1, kB2, kB3, kB4,
+      kC22, kC21, kC20, kC11, kC10, kC00, kD22, kD21, kD20, kD11, kD10, kD00,
+      kLpX, kLpY, kLpZ, kLpE, kLmX, kLmY, kLmZ, kLmE, kBX, kBY, kBZ, kBE, kBbarX, kBbarY, kBbarZ, kBbarE,
+      kP0, kP1, kP2, kP3, kP4, // quartic equation parameters
+      kNuX, kNuY, kNuZ, kNuE, kNubarX, kNubarY, kNubarZ, kNubarE, kInacc, kNan, kRoot,
+      kNColumns
+    };
+    std::vector<double> zCol[kNColumns]; // columns
+    std::vector<int> zHypEvent; // event of each hypothesis
+    std::vector<int> zHypBTag; // number of b-tagged jets of each hypothesis
+    std::vector<int> zHypNRoots; // number of roots of each hypothesis
+    std::vector<int> zEvFirstHyp; // first hypothesis of each event
+    std::vector<int> zEvStatus; // kinreco status of each event
+    std::vector<ZFourVector> zEvT, zEvTbar; // top and antitop of each event
+    int zNHyp; // number of hypotheses
+
+    // column data
+    double* Col(const int c) { return zCol[c].data(); }
+
+    // four vector from 4 columns (X, Y, Z, E) starting with c
+    ZFourVector Vector(const int c, const int i) const { return ZFourVector(zCol[c][i], zCol[c + 1][i], zCol[c + 2][i], zCol[c + 3][i]); }
+
+    // add hypothesis
+    void AddHypothesis(const ZKinRecoHalf& top, const ZKinRecoHalf& antitop, const double metX, const double metY)
+    {
+      const double val[kP0] =
+      {
+        metX, metY,
+        top.K1, top.K2, top.K3, top.K4, antitop.K1, antitop.K2, antitop.K3, antitop.K4,
+        top.Q22, top.Q21, top.Q20, top.Q11, top.Q10, top.Q00, antitop.D22, antitop.D21, antitop.D20, antitop.D11, antitop.D10, antitop.D00,
+        top.Lep->Px, top.Lep->Py, top.Lep->Pz, top.Lep->E, antitop.Lep->Px, antitop.Lep->Py, antitop.Lep->Pz, antitop.Lep->E,
+        top.Jet->Px, top.Jet->Py, top.Jet->Pz, top.Jet->E, antitop.Jet->Px, antitop.Jet->Py, antitop.Jet->Pz, antitop.Jet->E
+      };
+      for(int c = 0; c < kP0; c++)
+        zCol[c].push_back(val[c]);
+      zNHyp++;
+    }
+
+    // quartic equation parameters for all hypotheses: the same expressions as
+    // in SolveKinRecoDileptonPair() (see there for description)
+    void SolveCoefficients(const int n)
+    {
+      const double* c22v = Col(kC22); const double* c21v = Col(kC21); const double* c20v = Col(kC20);
+      const double* c11v = Col(kC11); const double* c10v = Col(kC10); const double* c00v = Col(kC00);
+      const double* d22v = Col(kD22); const double* d21v = Col(kD21); const double* d20v = Col(kD20);
+      const double* d11v = Col(kD11); const double* d10v = Col(kD10); const double* d00v = Col(kD00);
+      double* p0 = Col(kP0); double* p1 = Col(kP1); double* p2 = Col(kP2); double* p3 = Col(kP3); double* p4 = Col(kP4);
+      for(int i = 0; i < n; i++)
+      {
+        const double c22 = c22v[i], c21 = c21v[i], c20 = c20v[i], c11 = c11v[i], c10 = c10v[i], c00 = c00v[i];
+        const double d22 = d22v[i], d21 = d21v[i], d20 = d20v[i], d11 = d11v[i], d10 = d10v[i], d00 = d00v[i];
+        double h4 = c00 * c00 * d22 * d22 + c11 * d22 * (c11 * d00 - c00 * d11)
+                  + c00 * c22 * (d11 * d11 - 2 * d00 * d22) + c22 * d00 * (c22 * d00 - c11 * d11);
+        double h3 = c00 * d21 * (2 * c00 * d22 - c11 * d11) + c00 * d11 * (2 * c22 * d10 + c21 * d11)
+                  + c22 * d00 * (2 * c21 * d00 - c11 * d10) - c00 * d22 * (c11 * d10 + c10 * d11)
+                  -2 * c00 * d00 * (c22 * d21 + c21 * d22) - d00 * d11 * (c11 * c21 + c10 * c22)
+                  + c11 * d00 * (c11 * d21 + 2 * c10 * d22);
+        double h2 = c00 * c00 * (2 * d22 * d20 + d21 * d21) - c00 * d21 * (c11 * d10 + c10 * d11)
+                  + c11 * d20 * (c11 * d00 - c00 * d11) + c00 * d10 * (c22 * d10 - c10 * d22)
+                  + c00 * d11 * (2 * c21 * d10 + c20 * d11) + (2 * c22 * c20 + c21 * c21) * d00 * d00
+                  - 2 * c00 * d00 * (c22 * d20 + c21 * d21 + c20 * d22)
+                  + c10 * d00 * (2 * c11 * d21 + c10 * d22) - d00 * d10 * (c11 * c21 + c10 * c22)
+                  - d00 * d11 * (c11 * c20 + c10 * c21);
+        double h1 = c00 * d21 * (2 * c00 * d20 - c10 * d10) - c00 * d20 * (c11 * d10 + c10 * d11)
+                  + c00 * d10 * (c21 * d10 + 2 * c20 * d11) - 2 * c00 * d00 * (c21 * d20 + c20 * d21)
+                  + c10 * d00 * (2 * c11 * d20 + c10 * d21) + c20 * d00 * (2 * c21 * d00 - c10 * d11)
+                  - d00 * d10 * (c11 * c20 + c10 * c21);
+        double h0 = c00 * c00 * d20 * d20 + c10 * d20 * (c10 * d00 - c00 * d10)
+                  + c20 * d10 * (c00 * d10 - c10 * d00) + c20 * d00 * (c20 * d00 - 2 * c00 * d20);
+        // global scaling (pars = { h4, h3, h2, h1, h0 })
+        double minpar = 1e100;
+        if(TMath::Abs(h4) < minpar) minpar = h4;
+        if(TMath::Abs(h3) < minpar) minpar = h3;
+        if(TMath::Abs(h2) < minpar) minpar = h2;
+        if(TMath::Abs(h1) < minpar) minpar = h1;
+        if(TMath::Abs(h0) < minpar) minpar = h0;
+        p0[i] = h4 / minpar;
+        p1[i] = h3 / minpar;
+        p2[i] = h2 / minpar;
+        p3[i] = h1 / minpar;
+        p4[i] = h0 / minpar;
+      }
+    }
+
+    // neutrino momenta and inaccuracy for all hypotheses and roots (4 slots per hypothesis,
+    // slots without roots are calculated as well and ignored later): the same expressions
+    // as in SolveKinRecoDileptonPair() (see there for description)
+    void SolveNeutrinos(const int n)
+    {
+      const double massW = 80.4;
+      const double massTop = 172.5;
+      const double* exv = Col(kEx); const double* eyv = Col(kEy);
+      const double* a1v = Col(kA1); const double* a2v = Col(kA2); const double* a3v = Col(kA3); const double* a4v = Col(kA4);
+      const double* b1v = Col(kB1); const double* b2v = Col(kB2); const double* b3v = Col(kB3); const double* b4v = Col(kB4);
+      const double* c22v = Col(kC22); const double* c21v = Col(kC21); const double* c20v = Col(kC20);
+      const double* c11v = Col(kC11); const double* c10v = Col(kC10); const double* c00v = Col(kC00);
+      const double* d22v = Col(kD22); const double* d21v = Col(kD21); const double* d20v = Col(kD20);
+      const double* d11v = Col(kD11); const double* d10v = Col(kD10); const double* d00v = Col(kD00);
+      const double* lpx = Col(kLpX); const double* lpy = Col(kLpY); const double* lpz = Col(kLpZ); const double* lpe = Col(kLpE);
+      const double* lmx = Col(kLmX); const double* lmy = Col(kLmY); const double* lmz = Col(kLmZ); const double* lme = Col(kLmE);
+      const double* bx = Col(kBX); const double* by = Col(kBY); const double* bz = Col(kBZ); const double* be = Col(kBE);
+      const double* bbx = Col(kBbarX); const double* bby = Col(kBbarY); const double* bbz = Col(kBbarZ); const double* bbe = Col(kBbarE);
+      for(int r = 0; r < 4; r++)
+      {
+        const double* root = Col(kRoot) + r * n;
+        double* nuX = Col(kNuX) + r * n; double* nuY = Col(kNuY) + r * n; double* nuZ = Col(kNuZ) + r * n; double* nuE = Col(kNuE) + r * n;
+        double* nubarX = Col(kNubarX) + r * n; double* nubarY = Col(kNubarY) + r * n; double* nubarZ = Col(kNubarZ) + r * n; double* nubarE = Col(kNubarE) + r * n;
+        double* inacc = Col(kInacc) + r * n;
+        double* nan = Col(kNan) + r * n;
+        for(int i = 0; i < n; i++)
+        {
+          const double ex = exv[i];
+          const double ey = eyv[i];
+          // x components
+          double xn = root[i];
+          double xnbar = ex - xn;
+          // y components
+          double c0 = c00v[i];
+          double c1 = c11v[i] + c10v[i] * xn;
+          double c2 = c22v[i] + c21v[i] * xn + c20v[i] * xn * xn;
+          double d0 = d00v[i];
+          double d1 = d11v[i] + d10v[i] * xn;
+          double d2 = d22v[i] + d21v[i] * xn + d20v[i] * xn * xn;
+          double yn = (c0 * d2 - c2 * d0) / (c1 * d0 - c0 * d1);
+          double ynbar = ey - yn;
+          // z components
+          double zn = - (a1v[i] + a2v[i] * xn + a3v[i] * yn) / a4v[i];
+          double znbar = - (b1v[i] + b2v[i] * xnbar + b3v[i] * ynbar) / b4v[i];
+          // check nan
+          nan[i] = (xn != xn || xnbar != xnbar || yn != yn || ynbar != ynbar || zn != zn || znbar != znbar) ? 1.0 : 0.0;
+          // neutrinos (as ZFourVector::SetXYZM() with zero mass)
+          double en = TMath::Sqrt(xn * xn + yn * yn + zn * zn + 0.0 * 0.0);
+          double enbar = TMath::Sqrt(xnbar * xnbar + ynbar * ynbar + znbar * znbar + 0.0 * 0.0);
+          nuX[i] = xn; nuY[i] = yn; nuZ[i] = zn; nuE[i] = en;
+          nubarX[i] = xnbar; nubarY[i] = ynbar; nubarZ[i] = znbar; nubarE[i] = enbar;
+          // W bosons and top quarks (as sums of ZFourVector)
+          double wpx = lpx[i] + xn, wpy = lpy[i] + yn, wpz = lpz[i] + zn, wpe = lpe[i] + en;
+          double wmx = lmx[i] + xnbar, wmy = lmy[i] + ynbar, wmz = lmz[i] + znbar, wme = lme[i] + enbar;
+          double tx = wpx + bx[i], ty = wpy + by[i], tz = wpz + bz[i], te = wpe + be[i];
+          double tbx = wmx + bbx[i], tby = wmy + bby[i], tbz = wmz + bbz[i], tbe = wme + bbe[i];
+          // inaccuracy (masses as ZFourVector::M())
+          inacc[i] = TMath::Abs(Mass(wpx, wpy, wpz, wpe) - massW) + TMath::Abs(Mass(wmx, wmy, wmz, wme) - massW)
+                   + TMath::Abs(Mass(tx, ty, tz, te) - massTop) + TMath::Abs(Mass(tbx, tby, tbz, tbe) - massTop)
+                   + TMath::Abs((xn + xnbar) - ex) + TMath::Abs((yn + ynbar) - ey);
+        }
+      }
+    }
+
+    // invariant mass as ZFourVector::M()
+    static inline double Mass(const double x, const double y, const double z, const double e)
+    {
+      const double mm = e * e - (x * x + y * y + z * z);
+      return (mm < 0.0) ? -TMath::Sqrt(-mm) : TMath::Sqrt(mm);
+    }
+
+    // best root of provided hypothesis i (n hypotheses in total):
+    // as in SolveKinRecoDileptonPair() (see there for description)
+    bool SelectRoot(const int i, const int n, ZSolutionKinRecoDilepton& solution, TH1D* hInacc, int* ambiguity)
+    {
+      double weightBest = -1.0;
+      int rBest = -1;
+      for(int r = 0; r < zHypNRoots[i]; r++)
+      {
+        const int k = r * n + i;
+        if(zCol[kNan][k])
+        {
+          printf("SolveKinRecoDilepton: nan solution\n");
+          continue;
+        }
+        if(hInacc)
+          hInacc->Fill(zCol[kInacc][k]);
+        double wnu = KinRecoLandauWeight(zCol[kNuE][k]);
+        double wnubar = KinRecoLandauWeight(zCol[kNubarE][k]);
+        double weight = wnu * wnubar;
+        if(weight > weightBest)
+        {
+          weightBest = weight;
+          rBest = r;
+        }
+        if(ambiguity)
+          (*ambiguity)++;
+      }
+      if(weightBest < 0.0)
+        return false;
+      const int k = rBest * n + i;
+      ZFourVector nuBest(zCol[kNuX][k], zCol[kNuY][k], zCol[kNuZ][k], zCol[kNuE][k]);
+      ZFourVector nubarBest(zCol[kNubarX][k], zCol[kNubarY][k], zCol[kNubarZ][k], zCol[kNubarE][k]);
+      solution.zT = (nuBest + Vector(kLpX, i) + Vector(kBX, i));
+      solution.zTbar = (nubarBest + Vector(kLmX, i) + Vector(kBbarX, i));
+      solution.zWeight = weightBest;
+      return true;
+    }
+};
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+#endif
@@ -0,0 +1,208 @@
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>> Kinreco result cache >>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// Results of event selection and kinematic reconstruction do not depend
+// on histogram settings, so they are stored on disk (one binary file per
+// input sample, see eventreco() in eventReco.h) and histograms can be
+// refilled from this file without reading the input ntuples.
+// For every selected event and decay channel the run and event numbers,
+// MC event type, selected leptons, reconstructed top and antitop and
+// kinreco status are stored; for generator level, top and antitop of
+// MC signal events. Output weights are not stored (they are applied when
+// histograms are filled), so they can be changed without rerunning.
+// The cache file is identified by a key (see KinRecoCacheKey()) computed
+// from the input files (names, sizes, modification times), the maximum
+// number of events, the kinreco variant (neutrino weights and quartic
+// equation solver) and the code version
+// kKinRecoCacheVersion, which must be increased whenever event selection
+// or kinematic reconstruction is changed; a cache with a different key is
+// never used.
+
+#ifndef TTBAR_KINRECOCACHE_H
+#define TTBAR_KINRECOCACHE_H
+
+// C++ library or ROOT header files
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include <TString.h>
+#include "fourVector.h"
+#include "chainIndex.h"
+
+// code version: increase it when event selection or kinematic reconstruction is changed
+const int kKinRecoCacheVersion = 1;
+
+// content of the cache (bit mask): reco level for channels 1 ee, 2 mumu, 3 emu,
+// generator level (MC signal) and MC event types
+const int kKinRecoCacheGen = 1 << 3;
+const int kKinRecoCacheMCType = 1 << 4;
+inline int KinRecoCacheChannelBit(const int channel) { return 1 << (channel - 1); }
+
+// reco level result of one selected event in one channel
+struct ZKinRecoCacheReco
+{
+  int Run, Event; // run and event numbers
+  int McEventType; // MC event type (see tree.h), 0 for data
+  int Channel; // 1 ee, 2 mumu, 3 emu
+  int Status; // 1 selected (kinreco failed), 2 selected with successfull kinreco
+  ZFourVector LepM, LepP; // selected lepton- and lepton+
+  ZFourVector T, Tbar; // reconstructed top and antitop (if Status == 2)
+};
+
+// generator level top and antitop of one MC signal event
+struct ZKinRecoCacheGen
+{
+  int Run, Event; // run and event numbers
+  int McEventType; // MC event type (1 ee, 2 mumu, 3 emu)
+  ZFourVector T, Tbar; // top and antitop
+};
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>> Cache key >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// key of the cache for provided input file patterns (as for TChain::Add()),
+// maximum number of events and kinreco variant (tabulated neutrino weights and
+// quartic equation solver, see kinReco.h), see InputFilesHash() in chainIndex.h
+unsigned long long KinRecoCacheKey(const std::vector<TString>& patterns, const long maxNEvents, const int variant)
+{
+  unsigned long long h = HashBytes(&kKinRecoCacheVersion, sizeof(kKinRecoCacheVersion));
+  h = HashBytes(&maxNEvents, sizeof(maxNEvents), h);
+  h = HashBytes(&variant, sizeof(variant), h);
+  return InputFilesHash(patterns, h);
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>> ZKinRecoCache >>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Cached results of one input sample (records are in the order of input
+// events) and numbers of processed events (needed for event counters).
+// File format: header (see ZKinRecoCacheHeader), reco records, gen records.
+//
+class ZKinRecoCache
+{
+  public:
+    unsigned long long Key; // cache key (see KinRecoCacheKey())
+    int Content; // content bit mask (see kKinRecoCacheGen above)
+    long NEvents; // number of processed events
+    long NEventsType[4]; // numbers of processed events per MC event type (if kKinRecoCacheMCType)
+    std::vector<ZKinRecoCacheReco> Reco; // reco level results
+    std::vector<ZKinRecoCacheGen> Gen; // generator level top and antitop (if kKinRecoCacheGen)
+    // reco record indices of events in ZKinRecoBatch (filled when the batch is solved,
+    // see FlushKinRecoBatch() in eventReco.h)
+    std::vector<int> BatchRecord;
+
+    // constructor
+    ZKinRecoCache(const unsigned long long key = 0, const int content = 0): Key(key), Content(content)
+    {
+      Clear();
+    }
+
+    // erase all results
+    void Clear()
+    {
+      NEvents = 0;
+      for(int t = 0; t < 4; t++)
+        NEventsType[t] = 0;
+      Reco.clear();
+      Gen.clear();
+      BatchRecord.clear();
+    }
+
+    // append results of provided cache (following input events, e.g. from the next thread)
+    void Add(const ZKinRecoCache& cache)
+    {
+      NEvents += cache.NEvents;
+      for(int t = 0; t < 4; t++)
+        NEventsType[t] += cache.NEventsType[t];
+      Reco.insert(Reco.end(), cache.Reco.begin(), cache.Reco.end());
+      Gen.insert(Gen.end(), cache.Gen.begin(), cache.Gen.end());
+    }
+
+    // write to file (via temporary file, so that a concurrent reader never
+    // sees a partially written cache), returns true if successfull
+    bool Write(const TString& fileName) const
+    {
+      const TString fileNameTmp = TString::Format("%s.%d", fileName.Data(), (int)getpid());
+      FILE* f = fopen(fileNameTmp.Data(), "wb");
+      if(!f)
+      {
+        printf("Warning in ZKinRecoCache: can not write %s, results are not cached\n", fileName.Data());
+        return false;
+      }
+      ZKinRecoCacheHeader header;
+      memcpy(header.Magic, "ZKRCACHE", 8);
+      header.Version = kKinRecoCacheVersion;
+      header.Content = Content;
+      header.Key = Key;
+      header.NEvents = NEvents;
+      for(int t = 0; t < 4; t++)
+        header.NEventsType[t] = NEventsType[t];
+      header.NReco = Reco.size();
+      header.NGen = Gen.size();
+      bool ok = (fwrite(&header, sizeof(header), 1, f) == 1);
+      if(ok && Reco.size())
+        ok = (fwrite(&Reco[0], sizeof(ZKinRecoCacheReco), Reco.size(), f) == Reco.size());
+      if(ok && Gen.size())
+        ok = (fwrite(&Gen[0], sizeof(ZKinRecoCacheGen), Gen.size(), f) == Gen.size());
+      if(fclose(f) != 0 || !ok || rename(fileNameTmp.Data(), fileName.Data()) != 0)
+      {
+        printf("Warning in ZKinRecoCache: can not write %s, results are not cached\n", fileName.Data());
+        remove(fileNameTmp.Data());
+        return false;
+      }
+      return true;
+    }
+
+    // read from file: returns true if the file exists, has the same key as this
+    // object and contains at least Content of this object
+    bool Read(const TString& fileName)
+    {
+      Clear();
+      FILE* f = fopen(fileName.Data(), "rb");
+      if(!f)
+        return false;
+      ZKinRecoCacheHeader header;
+      bool ok = (fread(&header, sizeof(header), 1, f) == 1);
+      ok = ok && !memcmp(header.Magic, "ZKRCACHE", 8) && header.Version == kKinRecoCacheVersion && header.Key == Key;
+      ok = ok && (Content & ~header.Content) == 0 && header.NReco >= 0 && header.NGen >= 0;
+      if(ok)
+      {
+        Reco.resize(header.NReco);
+        Gen.resize(header.NGen);
+        if(Reco.size())
+          ok = (fread(&Reco[0], sizeof(ZKinRecoCacheReco), Reco.size(), f) == Reco.size());
+        if(ok && Gen.size())
+          ok = (fread(&Gen[0], sizeof(ZKinRecoCacheGen), Gen.size(), f) == Gen.size());
+      }
+      fclose(f);
+      if(!ok)
+      {
+        Clear();
+        return false;
+      }
+      Content = header.Content;
+      NEvents = header.NEvents;
+      for(int t = 0; t < 4; t++)
+        NEventsType[t] = header.NEventsType[t];
+      return true;
+    }
+
+  private:
+    // file header
+    struct ZKinRecoCacheHeader
+    {
+      char Magic[8]; // "ZKRCACHE"
+      int Version; // kKinRecoCacheVersion
+      int Content; // content bit mask
+      unsigned long long Key; // cache key
+      long long NEvents; // number of processed events
+      long long NEventsType[4]; // numbers of processed events per MC event type
+      long long NReco, NGen; // numbers of records
+    };
+};
+
+#endif
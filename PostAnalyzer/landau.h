@@ -0,0 +1,89 @@
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>> Tabulated Landau function >>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// Piecewise cubic approximation of TMath::Landau(x, mean, sigma) with
+// fixed mean and sigma, used for the neutrino energy weights in the
+// kinematic reconstruction (see kinReco.h): it is evaluated twice for
+// every root in every jet pair in every event.
+// The range [xMin, xMax] is split into intervals of equal width; in each
+// interval the function is the cubic polynomial through the exact values
+// at the interval edges and at both neighbouring nodes (4-point Lagrange
+// interpolation), stored as 4 coefficients, so the evaluation is one
+// table lookup and a Horner scheme without branches (vectorisable).
+// Outside the range TMath::Landau() is called.
+// The maximum relative error is measured when the table is built (at 3
+// points inside each interval, see MaxRelError()). For the kinreco table
+// (0 < E < 1500 GeV, 0.5 GeV steps) the interpolation error bound is
+// about 2e-5 near E = 0, where the weight is tiny, and below 1e-7 for
+// E > 30 GeV, where almost all weights are.
+
+#ifndef TTBAR_LANDAU_H
+#define TTBAR_LANDAU_H
+
+// C++ library or ROOT header files
+#include <TMath.h>
+#include <vector>
+
+class ZLandauTable
+{
+  public:
+    // constructor: table for TMath::Landau(x, mean, sigma) in [xMin, xMax] with nIntervals intervals
+    ZLandauTable(const double mean, const double sigma, const double xMin, const double xMax, const int nIntervals)
+    {
+      zMean = mean;
+      zSigma = sigma;
+      zXMin = xMin;
+      zXMax = xMax;
+      zN = nIntervals;
+      zStep = (xMax - xMin) / nIntervals;
+      // exact values at nodes, including one extra node on each side
+      std::vector<double> f(zN + 3);
+      for(int i = 0; i < zN + 3; i++)
+        f[i] = TMath::Landau(zXMin + (i - 1) * zStep, zMean, zSigma);
+      // cubic through nodes -1, 0, 1, 2 of each interval (t = 0 and 1 are the interval edges)
+      zCoef.resize(4 * zN);
+      for(int i = 0; i < zN; i++)
+      {
+        const double fm = f[i], f0 = f[i + 1], f1 = f[i + 2], f2 = f[i + 3];
+        double* c = &zCoef[4 * i];
+        c[0] = f0;
+        c[1] = -fm / 3 - f0 / 2 + f1 - f2 / 6;
+        c[2] = fm / 2 - f0 + f1 / 2;
+        c[3] = -fm / 6 + f0 / 2 - f1 / 2 + f2 / 6;
+      }
+      // maximum relative error
+      zMaxRelError = 0.0;
+      for(int i = 0; i < zN; i++)
+        for(int k = 1; k <= 3; k++)
+        {
+          const double x = zXMin + (i + 0.25 * k) * zStep;
+          const double exact = TMath::Landau(x, zMean, zSigma);
+          if(exact > 0.0)
+            zMaxRelError = TMath::Max(zMaxRelError, TMath::Abs(Eval(x) / exact - 1.0));
+        }
+    }
+
+    // approximated TMath::Landau(x, mean, sigma)
+    inline double Eval(const double x) const
+    {
+      if(!(x >= zXMin && x < zXMax))
+        return TMath::Landau(x, zMean, zSigma);
+      const double u = (x - zXMin) / zStep;
+      const int i = (int)u;
+      const double t = u - i;
+      const double* c = &zCoef[4 * i];
+      return c[0] + t * (c[1] + t * (c[2] + t * c[3]));
+    }
+
+    // maximum relative error measured when the table was built
+    double MaxRelError() const { return zMaxRelError; }
+
+  private:
+    double zMean, zSigma; // Landau parameters
+    double zXMin, zXMax, zStep; // range and interval width
+    int zN; // number of intervals
+    std::vector<double> zCoef; // 4 polynomial coefficients per interval
+    double zMaxRelError; // maximum relative error
+};
+
+#endif
@@ -0,0 +1,244 @@
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>> Preselection index >>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// For each input ntuple file a small binary file (sidecar, see
+// ZPreselIndex::SidecarName()) is stored with one 16-bit word per event:
+// primary vertex selection, the six trigger bits, dilepton pair found in
+// ee, mumu and emu (lepton selection only, without trigger and MET
+// requirements), at least two selected jets and MC event type (see
+// kPreselPV etc. below). With this bitmap the event loop (see EventLoop()
+// in eventReco.h) reads only candidate events, which can pass the reco
+// level selection in at least one needed channel (or are needed at
+// generator level); all other events are only counted.
+// The bitmap of a file is built once (by reading the file) and rebuilt
+// automatically if the modification time, size or number of entries of
+// the file has changed, or if kPreselIndexVersion has changed (increase
+// it whenever primary vertex, trigger, lepton or jet selection in
+// selection.h is changed). If the sidecar can not be written (e.g.
+// read-only directory), the bitmap is kept in memory only.
+
+#ifndef TTBAR_PRESELINDEX_H
+#define TTBAR_PRESELINDEX_H
+
+// C++ library or ROOT header files
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <TString.h>
+#include <TFile.h>
+#include <TTree.h>
+#include "tree.h"
+#include "selection.h"
+#include "chainIndex.h"
+
+// index version: increase it when primary vertex, trigger, lepton or jet selection is changed
+const int kPreselIndexVersion = 1;
+
+// bits of the event word
+const int kPreselPV = 1 << 0; // primary vertex selected
+inline int PreselTriggerBits(const int triggers) { return (triggers & 0x3f) << 1; } // trigger bits 0 to 5 (bits 1 to 6)
+inline int PreselDilepBit(const int channel) { return 1 << (6 + channel); } // dilepton pair in channel 1 ee, 2 mumu, 3 emu (bits 7 to 9)
+const int kPreselJets = 1 << 10; // at least two selected jets
+const int kPreselMCTypeShift = 12; // MC event type 0 to 3 (bits 12 and 13)
+
+// true if the event with provided word can pass reco level selection in provided channel
+inline bool PreselCandidate(const unsigned short word, const int channel)
+{
+  return (word & kPreselPV) && (word & kPreselJets) && (word & PreselDilepBit(channel)) && (word & PreselTriggerBits(TriggerMask(channel)));
+}
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>> ZPreselIndex >>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Event words of all files of a chain (global numbering of entries, as in
+// the chain built from ZChainIndex, see chainIndex.h).
+// Typical usage:
+//   ZPreselIndex presel;
+//   presel.Add(index); // ZChainIndex with all input files
+//   for(long e = presel.Next(first, last, channelMask, genTypeMask); e < last; e = presel.Next(e + 1, last, channelMask, genTypeMask))
+//     ...
+//
+class ZPreselIndex
+{
+  public:
+    // sidecar file name of provided input file (hidden file in the same directory)
+    static TString SidecarName(const TString& name)
+    {
+      const int slash = name.Last('/');
+      const TString dir = (slash >= 0) ? TString(name(0, slash + 1)) : TString("");
+      const TString base = name(slash + 1, name.Length() - slash - 1);
+      return TString::Format("%s.%s.zpresel", dir.Data(), base.Data());
+    }
+
+    // constructor: tree name in input files
+    ZPreselIndex(const TString& treeName = "tree"): zTreeName(treeName) {;}
+
+    // add all files of provided input files index (should be complete, see ZChainIndex::IsComplete())
+    void Add(const ZChainIndex& index)
+    {
+      for(size_t f = 0; f < index.Files().size(); f++)
+        Add(index.Files()[f], index.FileEntries()[f]);
+    }
+
+    // add provided file with nEntries entries: the words are read from its sidecar,
+    // or built from the file (and written to the sidecar)
+    void Add(const TString& name, const Long64_t nEntries)
+    {
+      struct stat st;
+      if(stat(name.Data(), &st) != 0)
+      {
+        printf("Error in ZPreselIndex::Add(): can not access file %s\n", name.Data());
+        exit(1);
+      }
+      const size_t offset = zWords.size();
+      zWords.resize(offset + nEntries);
+      if(nEntries == 0 || ReadSidecar(name, st, nEntries, &zWords[offset]))
+        return;
+      BuildFile(name, nEntries, &zWords[offset]);
+      WriteSidecar(name, st, nEntries, &zWords[offset]);
+    }
+
+    // number of indexed entries
+    long NEntries() const { return zWords.size(); }
+
+    // event word of provided entry
+    unsigned short Word(const long entry) const { return zWords[entry]; }
+
+    // MC event type of provided entry (0 for data)
+    int McEventType(const long entry) const { return (zWords[entry] >> kPreselMCTypeShift) & 3; }
+
+    // true if provided entry can pass reco level selection in any channel in channelMask
+    // (bit 1 << (channel - 1)) or its MC event type is in genTypeMask (bit 1 << mcEventType)
+    bool Candidate(const long entry, const int channelMask, const int genTypeMask) const
+    {
+      const unsigned short word = zWords[entry];
+      if(genTypeMask & (1 << ((word >> kPreselMCTypeShift) & 3)))
+        return true;
+      for(int ch = 1; ch <= 3; ch++)
+        if((channelMask & (1 << (ch - 1))) && PreselCandidate(word, ch))
+          return true;
+      return false;
+    }
+
+    // event list iteration: first candidate entry (see Candidate()) in [entry, last), last if there is none
+    long Next(long entry, const long last, const int channelMask, const int genTypeMask) const
+    {
+      while(entry < last && !Candidate(entry, channelMask, genTypeMask))
+        entry++;
+      return entry;
+    }
+
+  private:
+    TString zTreeName; // tree name
+    std::vector<unsigned short> zWords; // event words of all added files
+
+    // sidecar header
+    struct ZPreselHeader
+    {
+      char Magic[8]; // "ZPRESEL"
+      int Version; // kPreselIndexVersion
+      int Reserved; // (alignment)
+      long long MTime; // modification time of the input file
+      long long Size; // size of the input file
+      long long NEntries; // number of entries
+    };
+
+    // read words from the sidecar, returns false if it does not exist or does not match the file
+    bool ReadSidecar(const TString& name, const struct stat& st, const Long64_t nEntries, unsigned short* words) const
+    {
+      FILE* f = fopen(SidecarName(name).Data(), "rb");
+      if(!f)
+        return false;
+      ZPreselHeader header;
+      bool ok = (fread(&header, sizeof(header), 1, f) == 1);
+      ok = ok && !memcmp(header.Magic, "ZPRESEL", 8) && header.Version == kPreselIndexVersion;
+      ok = ok && header.MTime == (long long)st.st_mtime && header.Size == (long long)st.st_size && header.NEntries == nEntries;
+      ok = ok && (fread(words, sizeof(unsigned short), nEntries, f) == (size_t)nEntries);
+      fclose(f);
+      return ok;
+    }
+
+    // write words to the sidecar (via temporary file, so that a concurrent
+    // reader never sees a partially written sidecar)
+    void WriteSidecar(const TString& name, const struct stat& st, const Long64_t nEntries, const unsigned short* words) const
+    {
+      const TString sidecar = SidecarName(name);
+      const TString sidecarTmp = TString::Format("%s.%d", sidecar.Data(), (int)getpid());
+      FILE* f = fopen(sidecarTmp.Data(), "wb");
+      if(!f)
+      {
+        printf("Warning in ZPreselIndex: can not write %s, preselection index is not cached\n", sidecar.Data());
+        return;
+      }
+      ZPreselHeader header;
+      memset(&header, 0, sizeof(header));
+      memcpy(header.Magic, "ZPRESEL", 8);
+      header.Version = kPreselIndexVersion;
+      header.MTime = st.st_mtime;
+      header.Size = st.st_size;
+      header.NEntries = nEntries;
+      bool ok = (fwrite(&header, sizeof(header), 1, f) == 1);
+      ok = ok && (fwrite(words, sizeof(unsigned short), nEntries, f) == (size_t)nEntries);
+      if(fclose(f) != 0 || !ok || rename(sidecarTmp.Data(), sidecar.Data()) != 0)
+      {
+        printf("Warning in ZPreselIndex: can not write %s, preselection index is not cached\n", sidecar.Data());
+        remove(sidecarTmp.Data());
+      }
+    }
+
+    // build words of provided file (all needed branches are read)
+    void BuildFile(const TString& name, const Long64_t nEntries, unsigned short* words) const
+    {
+      printf("ZPreselIndex: indexing %s (%lld entries)\n", name.Data(), nEntries);
+      TFile* file = TFile::Open(name);
+      TTree* tree = (file && !file->IsZombie()) ? (TTree*)file->Get(zTreeName) : NULL;
+      if(!tree || tree->GetEntries() != nEntries)
+      {
+        printf("Error in ZPreselIndex: can not read %lld entries of tree %s from file %s\n", nEntries, zTreeName.Data(), name.Data());
+        exit(1);
+      }
+      // MC event type is stored if available
+      const bool flagMC = (tree->GetBranch(ZTree::BranchName(kBrMcEventType)) != NULL);
+      ZTree* preselTree = new ZTree(flagMC);
+      preselTree->Init(tree);
+      preselTree->SetReadSet(kReadSetPV | kReadSetTrig | kReadSetEl | kReadSetMu | kReadSetJets | ZBranchBit(kBrMcEventType));
+      ZJet vecJets[ZTree::maxNjet];
+      for(Long64_t e = 0; e < nEntries; e++)
+      {
+        preselTree->GetEntry(e);
+        int word = 0;
+        if(SelectPV(preselTree))
+          word |= kPreselPV;
+        word |= PreselTriggerBits(preselTree->Triggers);
+        // dilepton pairs (lepton selection only)
+        for(int ch = 1; ch <= 3; ch++)
+        {
+          ZFourVector vecLepM, vecLepP;
+          double maxPtDiLep = -1.0;
+          if(ch == 1)
+            SelectDilepEE(preselTree, vecLepM, vecLepP, maxPtDiLep);
+          else if(ch == 2)
+            SelectDilepMuMu(preselTree, vecLepM, vecLepP, maxPtDiLep);
+          else
+            SelectDilepEMu(preselTree, vecLepM, vecLepP, maxPtDiLep);
+          if(maxPtDiLep >= 0.0)
+            word |= PreselDilepBit(ch);
+        }
+        // jets (b-tagging is not used here)
+        bool oneBTagJet = false;
+        if(SelectJets(preselTree, 0.0, vecJets, oneBTagJet) >= 2)
+          word |= kPreselJets;
+        if(flagMC && preselTree->mcEventType >= 0 && preselTree->mcEventType < 4)
+          word |= preselTree->mcEventType << kPreselMCTypeShift;
+        words[e] = word;
+      }
+      delete preselTree;
+      file->Close();
+      delete file;
+    }
+};
+
+#endif
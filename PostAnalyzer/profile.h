@@ -0,0 +1,111 @@
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>> Stage profiling >>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// Wall time, CPU time and number of calls of the event reconstruction
+// stages (see EProfileStage below) are accumulated per thread if the
+// code is compiled with -DEVENTRECO_PROFILE (see compile.sh); otherwise
+// ZPROFILE_SCOPE() does nothing and there is no overhead at all.
+// ZPROFILE_SCOPE(stage) measures the time until the end of the current
+// scope (two clock_gettime() calls at each end, i.e. well below a
+// microsecond), stages are not nested. The profile of each event loop is
+// collected in eventreco (see eventReco.h), which prints it and writes
+// it as a JSON report next to each histogram file.
+
+#ifndef TTBAR_PROFILE_H
+#define TTBAR_PROFILE_H
+
+// C++ library or ROOT header files
+#include <time.h>
+
+// profiled stages
+enum EProfileStage
+{
+  kProfRead, // reading of input branches (ZTree::LoadEntry(), Load() and GetEntry())
+  kProfPVTrig, // primary vertex and trigger selection (SelectPV(), SelectTrigger())
+  kProfDilep, // dilepton selection (SelectDilep*())
+  kProfJets, // jet selection (SelectJets())
+  kProfKinReco, // kinematic reconstruction (KinRecoDilepton(), ZKinRecoBatch::Solve())
+  kProfFillHistos, // histogram filling (FillHistos())
+  kProfNStages // total number of stages
+};
+
+// stage name (used in the report)
+inline const char* ProfileStageName(const int stage)
+{
+  static const char* names[kProfNStages] = { "GetEntry", "PVTrigger", "SelectDilep", "Jets", "KinRecoDilepton", "FillHistos" };
+  return names[stage];
+}
+
+// accumulated times and numbers of calls of all stages
+struct ZProfile
+{
+  long Calls[kProfNStages]; // numbers of calls
+  double Wall[kProfNStages]; // wall times (seconds)
+  double Cpu[kProfNStages]; // CPU times of the calling threads (seconds)
+
+  // constructor
+  ZProfile() { Reset(); }
+
+  // set everything to zero
+  void Reset()
+  {
+    for(int s = 0; s < kProfNStages; s++)
+    {
+      Calls[s] = 0;
+      Wall[s] = Cpu[s] = 0.0;
+    }
+  }
+
+  // add provided profile (e.g. of another thread)
+  void Add(const ZProfile& p)
+  {
+    for(int s = 0; s < kProfNStages; s++)
+    {
+      Calls[s] += p.Calls[s];
+      Wall[s] += p.Wall[s];
+      Cpu[s] += p.Cpu[s];
+    }
+  }
+};
+
+// profile of the current thread (reset at the start of each event loop)
+thread_local ZProfile gProfileThread;
+
+// time of provided clock in seconds
+inline double ProfileClock(const clockid_t clock)
+{
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+// adds wall and CPU time from its construction to its destruction to the provided stage
+class ZProfileScope
+{
+  public:
+    ZProfileScope(const int stage): zStage(stage)
+    {
+      zWall = ProfileClock(CLOCK_MONOTONIC);
+      zCpu = ProfileClock(CLOCK_THREAD_CPUTIME_ID);
+    }
+    ~ZProfileScope()
+    {
+      gProfileThread.Cpu[zStage] += ProfileClock(CLOCK_THREAD_CPUTIME_ID) - zCpu;
+      gProfileThread.Wall[zStage] += ProfileClock(CLOCK_MONOTONIC) - zWall;
+      gProfileThread.Calls[zStage]++;
+    }
+
+  private:
+    int zStage; // profiled stage
+    double zWall, zCpu; // start times
+};
+
+#ifdef EVENTRECO_PROFILE
+const bool kProfileEnabled = true;
+#define ZPROFILE_SCOPE(stage) ZProfileScope zProfileScope(stage)
+#else
+const bool kProfileEnabled = false;
+#define ZPROFILE_SCOPE(stage)
+#endif
+
+#endif
@@ -0,0 +1,157 @@
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>> Real roots of quartic equation >>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// Closed-form solver (Descartes-Ferrari method) specialised for the
+// kinematic reconstruction (see kinReco.h): it is called for every
+// jet pair in every event, so it avoids any memory allocation and
+// the generic complex root finding of ROOT::Math::Polynomial.
+// Roots are polished with Newton iterations on the original polynomial.
+
+#ifndef TTBAR_QUARTIC_H
+#define TTBAR_QUARTIC_H
+
+// C++ library or ROOT header files
+#include <TMath.h>
+#include <cmath>
+#include <algorithm>
+
+// Evaluate polynomial p[0] + p[1]*x + ... + p[n]*x^n (Horner scheme)
+inline double EvalPolynomial(const double* p, const int n, const double x)
+{
+  double val = p[n];
+  for(int i = n - 1; i >= 0; i--)
+    val = val * x + p[i];
+  return val;
+}
+
+// Polish root x of polynomial p[0] + p[1]*x + ... + p[n]*x^n with (at most) nIter
+// Newton iterations, a step is accepted only if it does not increase the residual
+inline double PolishRoot(const double* p, const int n, double x, const int nIter = 2)
+{
+  double f = EvalPolynomial(p, n, x);
+  for(int it = 0; it < nIter && f != 0.0; it++)
+  {
+    double df = n * p[n];
+    for(int i = n - 1; i >= 1; i--)
+      df = df * x + i * p[i];
+    if(df == 0.0)
+      break;
+    const double xNew = x - f / df;
+    const double fNew = EvalPolynomial(p, n, xNew);
+    if(!(TMath::Abs(fNew) <= TMath::Abs(f)))
+      break;
+    x = xNew;
+    f = fNew;
+  }
+  return x;
+}
+
+// Real roots of x^2 + b*x + c = 0 (numerically stable form) stored in roots,
+// returns the number of roots (0 or 2)
+inline int SolveQuadraticReal(const double b, const double c, double* roots)
+{
+  const double disc = b * b - 4 * c;
+  if(disc < 0.0)
+    return 0;
+  const double q = -0.5 * (b + ((b >= 0.0) ? TMath::Sqrt(disc) : -TMath::Sqrt(disc)));
+  if(q == 0.0)
+  {
+    // b = c = 0: double root at 0
+    roots[0] = roots[1] = 0.0;
+    return 2;
+  }
+  roots[0] = q;
+  roots[1] = c / q;
+  return 2;
+}
+
+// Largest real root of x^3 + a*x^2 + b*x + c = 0
+inline double SolveCubicLargestReal(const double a, const double b, const double c)
+{
+  const double q = (a * a - 3 * b) / 9;
+  const double r = (2 * a * a * a - 9 * a * b + 27 * c) / 54;
+  const double q3 = q * q * q;
+  double x;
+  if(r * r < q3)
+  {
+    // three real roots
+    const double theta = TMath::ACos(r / TMath::Sqrt(q3));
+    const double sq = -2 * TMath::Sqrt(q);
+    const double x1 = sq * TMath::Cos(theta / 3) - a / 3;
+    const double x2 = sq * TMath::Cos((theta + 2 * TMath::Pi()) / 3) - a / 3;
+    const double x3 = sq * TMath::Cos((theta - 2 * TMath::Pi()) / 3) - a / 3;
+    x = std::max(x1, std::max(x2, x3));
+  }
+  else
+  {
+    // one real root
+    double s = cbrt(TMath::Abs(r) + TMath::Sqrt(r * r - q3));
+    if(r > 0.0)
+      s = -s;
+    const double t = (s != 0.0) ? (q / s) : 0.0;
+    x = s + t - a / 3;
+  }
+  const double p[4] = { c, b, a, 1.0 };
+  return PolishRoot(p, 3, x);
+}
+
+// Real roots of p[0] + p[1]*x + p[2]*x^2 + p[3]*x^3 + p[4]*x^4 = 0
+// (the same parameter order as for ROOT::Math::Polynomial) stored in roots
+// (at least 4 elements) in ascending order.
+// Returns the number of real roots (multiple roots are repeated), or -1 if
+// the equation is not a proper quartic (p[4] = 0 or not finite coefficients).
+inline int SolveQuarticReal(const double* p, double* roots)
+{
+  if(p[4] == 0.0)
+    return -1;
+  for(int i = 0; i < 5; i++)
+    if(!std::isfinite(p[i]))
+      return -1;
+  // normalised equation x^4 + a*x^3 + b*x^2 + c*x + d = 0
+  const double a = p[3] / p[4];
+  const double b = p[2] / p[4];
+  const double c = p[1] / p[4];
+  const double d = p[0] / p[4];
+  // depressed equation y^4 + pp*y^2 + qq*y + rr = 0 with x = y - a/4
+  const double a2 = a * a;
+  const double pp = b - 3 * a2 / 8;
+  const double qq = c - a * b / 2 + a2 * a / 8;
+  const double rr = d - a * c / 4 + a2 * b / 16 - 3 * a2 * a2 / 256;
+  // Descartes factorisation (y^2 + u*y + s) * (y^2 - u*y + t), where
+  // z = u^2 is the largest root of the resolvent cubic
+  // z^3 + 2*pp*z^2 + (pp^2 - 4*rr)*z - qq^2 = 0 (it is always non-negative)
+  const double z = SolveCubicLargestReal(2 * pp, pp * pp - 4 * rr, -qq * qq);
+  int n = 0;
+  if(z > 0.0)
+  {
+    const double u = TMath::Sqrt(z);
+    const double s = (pp + z - qq / u) / 2;
+    const double t = (pp + z + qq / u) / 2;
+    n += SolveQuadraticReal(u, s, roots + n);
+    n += SolveQuadraticReal(-u, t, roots + n);
+  }
+  else
+  {
+    // biquadratic equation y^4 + pp*y^2 + rr = 0
+    double w[2];
+    if(SolveQuadraticReal(pp, rr, w))
+      for(int i = 0; i < 2; i++)
+        if(w[i] >= 0.0)
+        {
+          roots[n++] = TMath::Sqrt(w[i]);
+          roots[n++] = -TMath::Sqrt(w[i]);
+        }
+  }
+  // shift back and polish, not finite roots are dropped
+  int nFinite = 0;
+  for(int i = 0; i < n; i++)
+  {
+    const double x = PolishRoot(p, 4, roots[i] - a / 4);
+    if(std::isfinite(x))
+      roots[nFinite++] = x;
+  }
+  std::sort(roots, roots + nFinite);
+  return nFinite;
+}
+
+#endif
@@ -4,16 +4,65 @@
 // Consult analysis documentation (papers, description-ttbar.pdf) for 
 // better description of applied cuts etc.
 
+#ifndef TTBAR_SELECTION_H
+#define TTBAR_SELECTION_H
+
 // additional files from this analysis 
 #include "tree.h"
-// C++ library or ROOT header files
-#include <TLorentzVector.h>
+#include "fourVector.h"
+#include "profile.h"
 
 // constants: electron and muon masses
 // (not the best practice to make them global variables, be aware)
 const double massEl = 0.000511;
 const double massMu = 0.105658;
 
+// branches read by electron and muon selection (see tree.h)
+const ZReadSet kReadSetEl = ZBranchBit(kBrNel) | ZBranchBit(kBrElPt) | ZBranchBit(kBrElEta) | ZBranchBit(kBrElPhi) 
+                          | ZBranchBit(kBrElIso03) | ZBranchBit(kBrElMissHits);
+const ZReadSet kReadSetMu = ZBranchBit(kBrNmu) | ZBranchBit(kBrMuPt) | ZBranchBit(kBrMuEta) | ZBranchBit(kBrMuPhi) 
+                          | ZBranchBit(kBrMuIso03) | ZBranchBit(kBrMuHitsValid) | ZBranchBit(kBrMuHitsPixel) 
+                          | ZBranchBit(kBrMuDistPV0) | ZBranchBit(kBrMuDistPVz) | ZBranchBit(kBrMuTrackChi2NDOF);
+// branches read by primary vertex, trigger and jet selection
+const ZReadSet kReadSetPV = ZBranchBit(kBrNpv) | ZBranchBit(kBrPvNDOF) | ZBranchBit(kBrPvZ) | ZBranchBit(kBrPvRho);
+const ZReadSet kReadSetTrig = ZBranchBit(kBrTriggers);
+const ZReadSet kReadSetJets = ZBranchBit(kBrNjet) | ZBranchBit(kBrJetPt) | ZBranchBit(kBrJetEta) | ZBranchBit(kBrJetPhi) 
+                            | ZBranchBit(kBrJetMass) | ZBranchBit(kBrJetMuEn) | ZBranchBit(kBrJetElEn) | ZBranchBit(kBrJetBTagDiscr);
+
+// Routine for primary vertex selection
+// Arguments:
+//   const ZTree* preselTree: input tree (see tree.h), GetEntry() should be done already
+// Returns true for selected event, false otherwise.
+bool SelectPV(const ZTree* preselTree)
+{
+  ZTREE_REQUIRE(preselTree, kReadSetPV, "SelectPV");
+  ZPROFILE_SCOPE(kProfPVTrig);
+  return !(preselTree->Npv < 1 || preselTree->pvNDOF < 4 || preselTree->pvRho > 2.0 || TMath::Abs(preselTree->pvZ) > 24.0);
+}
+
+// trigger bits used in given decay channel (1 ee: 2nd to 3rd bits, 
+// 2 mumu: 0th to 1st bits, 3 emu: 4th to 5th bits)
+inline int TriggerMask(const int channel)
+{
+  if(channel == 1)
+    return (1 << 2) | (1 << 3);
+  if(channel == 2)
+    return (1 << 0) | (1 << 1);
+  return (1 << 4) | (1 << 5);
+}
+
+// Routine for trigger selection
+// Arguments:
+//   const ZTree* preselTree: input tree (see tree.h), GetEntry() should be done already
+//   const int channel: decay channel (1 ee, 2 mumu, 3 emu)
+// Returns true if at least one needed trigger bit is fired, false otherwise.
+bool SelectTrigger(const ZTree* preselTree, const int channel)
+{
+  ZTREE_REQUIRE(preselTree, kReadSetTrig, "SelectTrigger");
+  ZPROFILE_SCOPE(kProfPVTrig);
+  return (preselTree->Triggers & TriggerMask(channel)) != 0;
+}
+
 // Routine for electron selection
 // Arguments:
 //   const ZTree* preselTree: input tree (see tree.h), GetEntry() should be done already
@@ -22,6 +71,7 @@ const double massMu = 0.105658;
 // See tree.h for ZTree variables description.
 bool SelectEl(const ZTree* preselTree, const int el)
 {
+  ZTREE_REQUIRE(preselTree, kReadSetEl, "SelectEl");
   // require pT(e) > 20 GeV
   if(TMath::Abs(preselTree->elPt[el]) < 20.0)
     return false;
@@ -49,6 +99,7 @@ bool SelectEl(const ZTree* preselTree, const int el)
 // See tree.h for ZTree variables description.
 bool SelectMu(const ZTree* preselTree, const int mu)
 {
+  ZTREE_REQUIRE(preselTree, kReadSetMu, "SelectMu");
   // require pT(mu) > 20 GeV
   if(TMath::Abs(preselTree->muPt[mu]) < 20.0)
     return false;
@@ -69,148 +120,197 @@ bool SelectMu(const ZTree* preselTree, const int mu)
   return true;
 }
 
-// routine for electron-muon pair selection
-// (select best e-mu pair in the event, with highest pT)
-// Arguments:
-//   const ZTree* preselTree: input tree (see tree.h), GetEntry() should be done already
-//   TLorentzVector& vecLepM: selected lepton- (output)
-//   TLorentzVector& vecLepP: selected lepton+ (output)
-//   double& maxPtDiLep: transverse momentum of the selected dilepton pair (output)
-// If no dilepton pair is selected, maxPtDiLep remains unchanged 
-// (not the best practice to make them global variables, be aware)
-void SelectDilepEMu(const ZTree* preselTree, TLorentzVector& vecLepM, TLorentzVector& vecLepP, double& maxPtDiLep)
+// Lepton candidate for dilepton pair search (see SelectDilep* routines below):
+// selection result and momentum are computed once per event (see PrepareEl() and PrepareMu())
+struct ZLeptonCand
+{
+  bool Pass; // true for selected lepton
+  float PtSigned; // pT from the tree (its sign is the lepton charge)
+  ZFourVector P; // four momentum (only for selected lepton)
+  double Pt; // transverse momentum (only for selected lepton)
+  
+  // set momentum from pT, eta, phi and mass
+  void SetPtEtaPhiM(const double pt, const double eta, const double phi, const double m)
+  {
+    P.SetPtEtaPhiM(pt, eta, phi, m);
+    Pt = P.Pt();
+  }
+};
+
+// prepare electron candidates (array cand should have at least preselTree->Nel elements), 
+// returns number of candidates
+int PrepareEl(const ZTree* preselTree, ZLeptonCand* cand)
 {
-  // loop over electrons
   for(int el = 0; el < preselTree->Nel; el++)
   {
-    // electron selection
-    if(!SelectEl(preselTree, el))
+    cand[el].PtSigned = preselTree->elPt[el];
+    cand[el].Pass = SelectEl(preselTree, el);
+    if(cand[el].Pass)
+      cand[el].SetPtEtaPhiM(TMath::Abs(preselTree->elPt[el]), preselTree->elEta[el], preselTree->elPhi[el], massEl);
+  }
+  return preselTree->Nel;
+}
+
+// prepare muon candidates (array cand should have at least preselTree->Nmu elements), 
+// returns number of candidates
+int PrepareMu(const ZTree* preselTree, ZLeptonCand* cand)
+{
+  for(int mu = 0; mu < preselTree->Nmu; mu++)
+  {
+    cand[mu].PtSigned = preselTree->muPt[mu];
+    cand[mu].Pass = SelectMu(preselTree, mu);
+    if(cand[mu].Pass)
+      cand[mu].SetPtEtaPhiM(TMath::Abs(preselTree->muPt[mu]), preselTree->muEta[mu], preselTree->muPhi[mu], massMu);
+  }
+  return preselTree->Nmu;
+}
+
+// search for the best (highest pT) opposite sign pair of prepared lepton candidates: 
+// 1st lepton from cand1, 2nd from cand2 (for same flavour, cand1 = cand2 and only 
+// pairs with 2nd lepton after 1st are considered); for same flavour, Z mass window 
+// is vetoed; pairs are scanned in the same order as in the original nested loops, 
+// and the last pair with sumPt >= maxPtDiLep is selected
+// (see SelectDilep* routines below for description of other arguments)
+void SelectDilepPair(const ZLeptonCand* cand1, const int n1, const ZLeptonCand* cand2, const int n2, const bool sameFlavour, 
+                     ZFourVector& vecLepM, ZFourVector& vecLepP, double& maxPtDiLep)
+{
+  for(int l1 = 0; l1 < n1; l1++)
+  {
+    const ZLeptonCand& c1 = cand1[l1];
+    if(!c1.Pass)
       continue;
-    TLorentzVector thisEl;
-    thisEl.SetPtEtaPhiM(TMath::Abs(preselTree->elPt[el]), preselTree->elEta[el], preselTree->elPhi[el], massEl);
-    // loop over muons
-    for(int mu = 0; mu < preselTree->Nmu; mu++)
+    for(int l2 = sameFlavour ? (l1 + 1) : 0; l2 < n2; l2++)
     {
+      const ZLeptonCand& c2 = cand2[l2];
       // require opposite signs
-      if(preselTree->elPt[el] * preselTree->muPt[mu] > 0)
+      if(c1.PtSigned * c2.PtSigned > 0)
         continue;
-      // muon selection
-      if(!SelectMu(preselTree, mu))
+      if(!c2.Pass)
         continue;
-      TLorentzVector thisMu;
-      thisMu.SetPtEtaPhiM(TMath::Abs(preselTree->muPt[mu]), preselTree->muEta[mu], preselTree->muPhi[mu], massMu);
+      // dilepton invariant mass
+      const double m = (c1.P + c2.P).M();
       // require dilepton mass greater than 20 GeV
-      TLorentzVector vecDiLep = thisEl + thisMu;
-      if(vecDiLep.M() < 20.0)
+      if(m < 20.0)
+        continue;
+      // this is additional invariant mass requirement for ee and mumu
+      // (to supress Drell-Yan background)
+      if(sameFlavour && m > 76.0 && m < 106.0)
         continue;
-      // select pair with highest transverse momentum
-      double sumPt = thisMu.Pt() + thisEl.Pt();
+      // select pair with highest transverse momenta
+      double sumPt = c2.Pt + c1.Pt;
       if(sumPt < maxPtDiLep)
         continue;
       maxPtDiLep = sumPt;
-      // assign el and mu momenta to output l+ and l- vectors
-      vecLepM = (preselTree->elPt[el] < 0) ? thisEl : thisMu;
-      vecLepP = (preselTree->elPt[el] < 0) ? thisMu : thisEl;
+      // assign lepton momenta to output l+ and l- vectors
+      vecLepM = (c1.PtSigned < 0) ? c1.P : c2.P;
+      vecLepP = (c1.PtSigned < 0) ? c2.P : c1.P;
     }
   }
 }
 
+// routine for electron-muon pair selection
+// (select best e-mu pair in the event, with highest pT)
+// Arguments:
+//   const ZTree* preselTree: input tree (see tree.h), GetEntry() should be done already
+//   ZFourVector& vecLepM: selected lepton- (output)
+//   ZFourVector& vecLepP: selected lepton+ (output)
+//   double& maxPtDiLep: transverse momentum of the selected dilepton pair (output)
+// If no dilepton pair is selected, maxPtDiLep remains unchanged 
+// (not the best practice to make them global variables, be aware)
+void SelectDilepEMu(const ZTree* preselTree, ZFourVector& vecLepM, ZFourVector& vecLepP, double& maxPtDiLep)
+{
+  ZTREE_REQUIRE(preselTree, kReadSetEl | kReadSetMu, "SelectDilepEMu");
+  ZPROFILE_SCOPE(kProfDilep);
+  ZLeptonCand candEl[ZTree::maxNel];
+  ZLeptonCand candMu[ZTree::maxNmu];
+  const int nEl = PrepareEl(preselTree, candEl);
+  const int nMu = PrepareMu(preselTree, candMu);
+  SelectDilepPair(candEl, nEl, candMu, nMu, false, vecLepM, vecLepP, maxPtDiLep);
+}
+
 // routine for electron-electron pair selection
 // (select best e-e pair in the event, with highest pT)
 // Arguments:
 //   const ZTree* preselTree: input tree (see tree.h), GetEntry() should be done already
-//   TLorentzVector& vecLepM: selected lepton- (output)
-//   TLorentzVector& vecLepP: selected lepton+ (output)
+//   ZFourVector& vecLepM: selected lepton- (output)
+//   ZFourVector& vecLepP: selected lepton+ (output)
 //   double& maxPtDiLep: transverse momentum of the selected dilepton pair (output)
 // If no dilepton pair is selected, maxPtDiLep remains unchanged 
 // (not the best practice to make them global variables, be aware)
-void SelectDilepEE(const ZTree* preselTree, TLorentzVector& vecLepM, TLorentzVector& vecLepP, double& maxPtDiLep)
+void SelectDilepEE(const ZTree* preselTree, ZFourVector& vecLepM, ZFourVector& vecLepP, double& maxPtDiLep)
 {
-  // loop over 1st electron
-  for(int el1 = 0; el1 < preselTree->Nel; el1++)
-  {
-    // electron selection
-    if(!SelectEl(preselTree, el1))
-      continue;
-    TLorentzVector thisEl1;
-    thisEl1.SetPtEtaPhiM(TMath::Abs(preselTree->elPt[el1]), preselTree->elEta[el1], preselTree->elPhi[el1], massEl);
-    // loop over 2nd electron
-    for(int el2 = el1 + 1; el2 < preselTree->Nel; el2++)
-    {
-      // require opposite signs
-      if(preselTree->elPt[el1] * preselTree->elPt[el2] > 0)
-        continue;
-      // electron selection
-      if(!SelectEl(preselTree, el2))
-        continue;
-      TLorentzVector thisEl2;
-      thisEl2.SetPtEtaPhiM(TMath::Abs(preselTree->elPt[el2]), preselTree->elEta[el2], preselTree->elPhi[el2], massEl);
-      // require dilepton mass greater than 20 GeV
-      TLorentzVector vecDiLep = thisEl1 + thisEl2;
-      if(vecDiLep.M() < 20.0)
-        continue;
-      // this is additional invariant mass requirement for ee and mumu
-      // (to supress Drell-Yan background)
-      if(vecDiLep.M() > 76.0 && vecDiLep.M() < 106.0)
-        continue;
-      // select pair with highest transverse momenta
-      double sumPt = thisEl1.Pt() + thisEl2.Pt();
-      if(sumPt < maxPtDiLep)
-        continue;
-      maxPtDiLep = sumPt;
-      // assign el and mu momenta to output l+ and l- vectors
-      vecLepM = (preselTree->elPt[el1] < 0) ? thisEl1 : thisEl2;
-      vecLepP = (preselTree->elPt[el1] < 0) ? thisEl2 : thisEl1;
-    }
-  }
+  ZTREE_REQUIRE(preselTree, kReadSetEl, "SelectDilepEE");
+  ZPROFILE_SCOPE(kProfDilep);
+  ZLeptonCand candEl[ZTree::maxNel];
+  const int nEl = PrepareEl(preselTree, candEl);
+  SelectDilepPair(candEl, nEl, candEl, nEl, true, vecLepM, vecLepP, maxPtDiLep);
 }
 
 // routine for muon-muon pair selection
 // (select best mu-mu pair in the event, with highest pT)
 // Arguments:
 //   const ZTree* preselTree: input tree (see tree.h), GetEntry() should be done already
-//   TLorentzVector& vecLepM: selected lepton- (output)
-//   TLorentzVector& vecLepP: selected lepton+ (output)
+//   ZFourVector& vecLepM: selected lepton- (output)
+//   ZFourVector& vecLepP: selected lepton+ (output)
 //   double& maxPtDiLep: transverse momentum of the selected dilepton pair (output)
 // If no dilepton pair is selected, maxPtDiLep remains unchanged 
 // (not the best practice to make them global variables, be aware)
-void SelectDilepMuMu(const ZTree* preselTree, TLorentzVector& vecLepM, TLorentzVector& vecLepP, double& maxPtDiLep)
+void SelectDilepMuMu(const ZTree* preselTree, ZFourVector& vecLepM, ZFourVector& vecLepP, double& maxPtDiLep)
 {
-  // loop over 1st muon
-  for(int mu1 = 0; mu1 < preselTree->Nmu; mu1++)
+  ZTREE_REQUIRE(preselTree, kReadSetMu, "SelectDilepMuMu");
+  ZPROFILE_SCOPE(kProfDilep);
+  ZLeptonCand candMu[ZTree::maxNmu];
+  const int nMu = PrepareMu(preselTree, candMu);
+  SelectDilepPair(candMu, nMu, candMu, nMu, true, vecLepM, vecLepP, maxPtDiLep);
+}
+
+// Routine for jet selection (all selected jets are stored for kinematic reconstruction)
+// Arguments:
+//   const ZTree* preselTree: input tree (see tree.h), GetEntry() should be done already
+//   const double bTagDiscr: b-tagging discriminator threshold
+//   ZJet* vecJets: selected jets (output, array should have at least ZTree::maxNjet elements)
+//   bool& oneBTagJet: true if there is at least one b-tagged jet (output)
+// Returns number of selected jets.
+int SelectJets(const ZTree* preselTree, const double bTagDiscr, ZJet* vecJets, bool& oneBTagJet)
+{
+  ZTREE_REQUIRE(preselTree, kReadSetJets, "SelectJets");
+  ZPROFILE_SCOPE(kProfJets);
+  int nJets = 0;
+  oneBTagJet = false;
+  for(int j = 0; j < preselTree->Njet; j++)
   {
-    // muon selection
-    if(!SelectMu(preselTree, mu1))
+    if(TMath::Abs(preselTree->jetEta[j]) > 2.4)
       continue;
-    TLorentzVector thisMu1;
-    thisMu1.SetPtEtaPhiM(TMath::Abs(preselTree->muPt[mu1]), preselTree->muEta[mu1], preselTree->muPhi[mu1], massMu);
-    // loop over 2nd muon
-    for(int mu2 = mu1 + 1; mu2 < preselTree->Nmu; mu2++)
-    {
-      // require opposite signs
-      if(preselTree->muPt[mu1] * preselTree->muPt[mu2] > 0)
-        continue;
-      // muon selection
-      if(!SelectMu(preselTree, mu2))
-        continue;
-      TLorentzVector thisMu2;
-      thisMu2.SetPtEtaPhiM(TMath::Abs(preselTree->muPt[mu2]), preselTree->muEta[mu2], preselTree->muPhi[mu2], massMu);
-      // require dilepton mass greater than 20 GeV
-      TLorentzVector vecDiLep = thisMu1 + thisMu2;
-      if(vecDiLep.M() < 20.0)
-        continue;
-      // this is additional invariant mass requirement for ee and mumu
-      // (to supress Drell-Yan background)
-      if(vecDiLep.M() > 76.0 && vecDiLep.M() < 106.0)
-        continue;
-      // select pair with highest transverse momenta
-      double sumPt = thisMu1.Pt() + thisMu2.Pt();
-      if(sumPt < maxPtDiLep)
-        continue;
-      maxPtDiLep = sumPt;
-      // assign el and mu momenta to output l+ and l- vectors
-      vecLepM = (preselTree->muPt[mu1] < 0) ? thisMu1 : thisMu2;
-      vecLepP = (preselTree->muPt[mu1] < 0) ? thisMu2 : thisMu1;
-    }
+    ZFourVector vecJet;
+    vecJet.SetPtEtaPhiM(preselTree->jetPt[j], preselTree->jetEta[j], preselTree->jetPhi[j], preselTree->jetMass[j]);
+    // subtract muon and electron energy fractions
+    double corrE = vecJet.E - preselTree->jetMuEn[j] - preselTree->jetElEn[j];
+    double corrPt = preselTree->jetPt[j] * corrE / vecJet.E;
+    // require pT(jet) > 30 GeV
+    if(corrPt < 30.0)
+      continue;
+    ZJet& jet = vecJets[nJets++];
+    jet.P.SetPtEtaPhiE(corrPt, preselTree->jetEta[j], preselTree->jetPhi[j], corrE);
+    // b-tagging (flag is used in the kinematic reconstruction): 
+    // check if there at least one b-tagged jet
+    jet.BTag = (preselTree->jetBTagDiscr[j] > bTagDiscr);
+    if(jet.BTag)
+      oneBTagJet = true;
   }
+  return nJets;
 }
+
+// Fast check before jet selection: returns true if there is at least one jet 
+// within |eta| < 2.4 with b-tagging discriminator above bTagDiscr (this is needed 
+// for a b-tagged selected jet, see SelectJets() above, so no event is lost)
+bool AnyBTagJet(const ZTree* preselTree, const double bTagDiscr)
+{
+  ZTREE_REQUIRE(preselTree, kReadSetJets, "AnyBTagJet");
+  ZPROFILE_SCOPE(kProfJets);
+  for(int j = 0; j < preselTree->Njet; j++)
+    if(!(TMath::Abs(preselTree->jetEta[j]) > 2.4) && preselTree->jetBTagDiscr[j] > bTagDiscr)
+      return true;
+  return false;
+}
+
+#endif
@@ -18,6 +18,8 @@ TString gDataDir  = gBaseDir + "./ntuples-data"; // directory with data ntuples
 TString gMcDir    = gBaseDir + "./ntuples-mc"; // directory with MC ntuples
 TString gHistDir  = gBaseDir + "./hist"; // directory with histograms
 TString gPlotsDir = gBaseDir + "./plots"; // directory with final plots
+TString gCacheDir = gBaseDir + "./cache"; // directory with kinreco result cache (see kinRecoCache.h)
+TString gSkimDir  = gBaseDir + "./skims"; // directory with skims of input ntuples (see skim.h)
 //
 // For exercises, you could use existing "reference" histograms 
 // (they are provided at git) to produce final plots, or even existing 
@@ -26,6 +28,8 @@ TString gPlotsDir = gBaseDir + "./plots"; // directory with final plots
 //TString gDataDir  = gBaseDir + "./ntuples-data-REF";
 //TString gMcDir    = gBaseDir + "./ntuples-mc-REF";
 //TString gHistDir  = gBaseDir + "./hist-REF";
+// or synthetic MC ntuples for load tests (see ttbarMakeNtuples.cxx)
+//TString gMcDir    = gBaseDir + "./ntuples-mc-synth";
 //
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 
@@ -0,0 +1,252 @@
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>> Skims >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// Only a small fraction of input events pass the primary vertex, trigger
+// and dilepton selection, so these events are copied (all branches of
+// ZTree, see tree.h) to a skim: a set of ROOT files with the same tree,
+// which is read by eventreco (see eventReco.h) instead of the input
+// ntuples. The MET cut, jet selection and kinematic reconstruction are
+// done on the skim, so they can be changed without rerunning on the full
+// ntuples (MET is not a preselection cut, see cutFlow.h).
+// One skim is written per input sample and content (decay channels, see
+// KinRecoCacheContent() in eventReco.h); with the generator level of
+// MC signal all signal events are kept as well. The skim is written by
+// the event loop, one file (part) per thread: for the part of the events
+// processed by each thread, the skimmed events are stored in the order
+// of the input events, so the whole skim is in the same order.
+// Each part contains provenance metadata (TNamed objects):
+//   "skimInfo": selection version kSkimVersion, skim key (see SkimKey()),
+//               stamp of the writing job, part number, number of parts,
+//               content, numbers of processed events (needed for event
+//               counters) and number of skimmed events;
+//   "skimInputs": input file patterns (one per line).
+// The skim is identified by a key computed from the input files (names,
+// sizes, modification times), the maximum number of events, the content
+// and kSkimVersion, which must be increased whenever the primary vertex,
+// trigger or dilepton selection is changed; a skim with a different key
+// or an incomplete skim is never used.
+
+#ifndef TTBAR_SKIM_H
+#define TTBAR_SKIM_H
+
+// C++ library or ROOT header files
+#include <vector>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <TString.h>
+#include <TFile.h>
+#include <TTree.h>
+#include <TNamed.h>
+#include <TDirectory.h>
+#include "tree.h"
+#include "chainIndex.h"
+#include "kinRecoCache.h"
+
+// selection version: increase it when primary vertex, trigger or dilepton selection is changed
+// (version 2: MET cut is not applied to the skim)
+const int kSkimVersion = 2;
+
+// key of the skim for provided input file patterns (as for TChain::Add()),
+// maximum number of events and content (see KinRecoCacheContent() in eventReco.h),
+// see InputFilesHash() in chainIndex.h
+unsigned long long SkimKey(const std::vector<TString>& patterns, const long maxNEvents, const int content)
+{
+  unsigned long long h = HashBytes(&kSkimVersion, sizeof(kSkimVersion));
+  h = HashBytes(&maxNEvents, sizeof(maxNEvents), h);
+  h = HashBytes(&content, sizeof(content), h);
+  return InputFilesHash(patterns, h);
+}
+
+// name of the skim part file (base is the directory and name of the skim)
+inline TString SkimPartName(const TString& base, const int part)
+{
+  return TString::Format("%s_%03d.root", base.Data(), part);
+}
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>> ZSkimInfo >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Metadata of an existing skim, read from all its parts.
+//
+struct ZSkimInfo
+{
+  long NEvents; // number of processed input events
+  long NEventsType[4]; // numbers of processed input events per MC event type (if kKinRecoCacheMCType)
+  long NSkim; // number of skimmed events
+  std::vector<TString> Files; // parts with skimmed events (to be added to the chain)
+
+  // constructor
+  ZSkimInfo(): NEvents(0), NSkim(0)
+  {
+    for(int t = 0; t < 4; t++)
+      NEventsType[t] = 0;
+  }
+
+  // read metadata of skim base (see SkimPartName()): returns true if all parts
+  // exist, have provided key and were written by the same job
+  bool Read(const TString& base, const unsigned long long key)
+  {
+    *this = ZSkimInfo();
+    TString stamp0;
+    int nParts = 1;
+    for(int p = 0; p < nParts; p++)
+    {
+      const TString name = SkimPartName(base, p);
+      struct stat st;
+      if(stat(name.Data(), &st) != 0)
+        return false;
+      TFile* file = TFile::Open(name);
+      TNamed* info = (file && !file->IsZombie()) ? (TNamed*)file->Get("skimInfo") : NULL;
+      int version = 0, part = -1, nPartsFile = 0, content = 0;
+      unsigned long long keyFile = 0;
+      char stamp[64];
+      long nEvents = 0, nEventsType[4], nSkim = 0;
+      bool ok = info && sscanf(info->GetTitle(), "%d %llx %63s %d %d %d %ld %ld %ld %ld %ld %ld", &version, &keyFile, stamp, &part, &nPartsFile, &content,
+                               &nEvents, &nEventsType[0], &nEventsType[1], &nEventsType[2], &nEventsType[3], &nSkim) == 12;
+      if(file)
+      {
+        file->Close();
+        delete file;
+      }
+      ok = ok && version == kSkimVersion && keyFile == key && part == p;
+      if(ok && p == 0)
+      {
+        nParts = nPartsFile;
+        stamp0 = stamp;
+      }
+      if(!ok || nPartsFile != nParts || stamp0 != stamp)
+      {
+        *this = ZSkimInfo();
+        return false;
+      }
+      NEvents += nEvents;
+      for(int t = 0; t < 4; t++)
+        NEventsType[t] += nEventsType[t];
+      NSkim += nSkim;
+      // parts without events have no tree
+      if(nSkim > 0)
+        Files.push_back(name);
+    }
+    return true;
+  }
+};
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>> ZSkimWriter >>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Writes one skim part: events are counted and filled in the event loop
+// (see SkimEvent() in eventReco.h), the file is written via a temporary
+// file in Close(), so that a reader never sees a partially written part.
+// The output tree is a clone of the input chain (active branches only,
+// see ZTree::SetReadSet()), created when the first event is filled.
+//
+class ZSkimWriter
+{
+  public:
+    long NEvents; // number of processed input events
+    long NEventsType[4]; // numbers of processed input events per MC event type (if kKinRecoCacheMCType)
+    long NSkim; // number of skimmed events
+
+    // constructor: skim base (see SkimPartName()), part number and number of parts,
+    // key and content (see SkimKey()), stamp of the writing job (the same for all
+    // parts) and input file patterns (stored as provenance)
+    ZSkimWriter(const TString& base, const int part, const int nParts, const unsigned long long key, const int content,
+                const TString& stamp, const std::vector<TString>& inputs):
+      zPart(part), zNParts(nParts), zKey(key), zContent(content), zStamp(stamp), zInputs(inputs), zFile(NULL), zTree(NULL)
+    {
+      zFileName = SkimPartName(base, part);
+      zFileNameTmp = TString::Format("%s.%d", zFileName.Data(), (int)getpid());
+      NEvents = NSkim = 0;
+      for(int t = 0; t < 4; t++)
+        NEventsType[t] = 0;
+    }
+
+    // destructor
+    ~ZSkimWriter()
+    {
+      if(zFile)
+      {
+        zFile->Close();
+        delete zFile;
+        remove(zFileNameTmp.Data());
+      }
+    }
+
+    // content bit mask (see KinRecoCacheContent() in eventReco.h)
+    int Content() const { return zContent; }
+
+    // write the current event of provided tree (all active branches are read)
+    void Fill(ZTree* tree, const long entry)
+    {
+      if(!zTree)
+      {
+        Open();
+        TDirectory* dir = gDirectory;
+        zFile->cd();
+        zTree = tree->fChain->CloneTree(0);
+        dir->cd();
+      }
+      tree->GetEntry(entry);
+      zTree->Fill();
+      NSkim++;
+    }
+
+    // write tree and metadata and close the file, returns true if successfull
+    bool Close()
+    {
+      if(!zFile)
+        Open();
+      TDirectory* dir = gDirectory;
+      zFile->cd();
+      if(zTree)
+        zTree->Write();
+      TNamed info("skimInfo", TString::Format("%d %016llx %s %d %d %d %ld %ld %ld %ld %ld %ld", kSkimVersion, zKey, zStamp.Data(), zPart, zNParts, zContent,
+                                              NEvents, NEventsType[0], NEventsType[1], NEventsType[2], NEventsType[3], NSkim));
+      info.Write();
+      TString inputs;
+      for(int f = 0; f < zInputs.size(); f++)
+        inputs += zInputs[f] + "\n";
+      TNamed namedInputs("skimInputs", inputs);
+      namedInputs.Write();
+      dir->cd();
+      zFile->Close();
+      delete zFile;
+      zFile = NULL;
+      zTree = NULL;
+      if(rename(zFileNameTmp.Data(), zFileName.Data()) != 0)
+      {
+        printf("Warning in ZSkimWriter: can not write %s, skim is not stored\n", zFileName.Data());
+        remove(zFileNameTmp.Data());
+        return false;
+      }
+      return true;
+    }
+
+  private:
+    int zPart, zNParts; // part number and number of parts
+    unsigned long long zKey; // skim key
+    int zContent; // content bit mask
+    TString zStamp; // stamp of the writing job
+    std::vector<TString> zInputs; // input file patterns
+    TString zFileName, zFileNameTmp; // part file name and temporary file name
+    TFile* zFile; // output file
+    TTree* zTree; // output tree (owned by zFile)
+
+    // open temporary output file
+    void Open()
+    {
+      TDirectory* dir = gDirectory;
+      zFile = TFile::Open(zFileNameTmp, "recreate");
+      dir->cd();
+      if(!zFile || zFile->IsZombie())
+      {
+        printf("Error in ZSkimWriter: can not write %s\n", zFileNameTmp.Data());
+        exit(1);
+      }
+    }
+};
+
+#endif
@@ -0,0 +1,373 @@
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>> Synthetic ttbar events >>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// Dilepton ttbar events generated with Decay() (see kinReco.h), for
+// benchmarks and load tests without real ntuples (see ttbarMicroBench.cxx
+// and ttbarMakeNtuples.cxx):
+//   ttbar -> t tbar, t -> b W+, W+ -> l+ nu, tbar -> bbar W-, W- -> l- nubar
+// with on-shell top and W (the same masses as in the kinematic
+// reconstruction), ttbar mass, transverse momentum and rapidity from
+// simple falling spectra; other ttbar events (MC event type 0) have one
+// W decaying into quarks (two light jets). Leptons and jets are smeared,
+// extra (light) jets, pile-up jets and extra leptons (mostly not
+// isolated) are added, and the missing transverse energy is the sum of
+// the neutrinos, corrected for the smearing and smeared itself (more
+// with pile-up). Events are reproducible: the same random generator
+// seed gives the same events.
+// SynthFillTree() sets the ntuple variables of ZTree (see tree.h) from
+// a generated event (reco level variables and MC truth), so that the
+// selection routines (see selection.h) can be run on it, and
+// SynthBookBranches() creates the branches of an output tree with the
+// same layout as the ntuples written by Analyzer.
+
+#ifndef TTBAR_SYNTHEVENT_H
+#define TTBAR_SYNTHEVENT_H
+
+// additional files from this analysis
+#include "tree.h"
+#include "kinReco.h"
+#include "selection.h"
+// C++ library or ROOT header files
+#include <TRandom3.h>
+#include <TLorentzVector.h>
+#include <TTree.h>
+
+// masses used for generation (top and W as in the kinematic reconstruction, see kinReco.h)
+const double kSynthMassTop = 172.5;
+const double kSynthMassW = 80.4;
+const double kSynthMassB = 4.8;
+
+// settings of synthetic events
+struct ZSynthSettings
+{
+  double NExtraJets; // mean number of extra (light) jets (Poisson)
+  double NExtraLep; // mean number of extra leptons (Poisson), mostly not isolated
+  double JetSmear; // relative jet energy resolution
+  double LepSmear; // relative lepton momentum resolution
+  double METSmear; // resolution of missing transverse energy components (GeV)
+  double BTagEff; // b-tagging efficiency of b jets (for discriminator threshold 0.244)
+  double BTagMistag; // b-tagging mistag rate of light jets
+  double PileUp; // mean number of pile-up interactions (Poisson)
+
+  // constructor (default settings)
+  ZSynthSettings()
+  {
+    NExtraJets = 2.0;
+    NExtraLep = 1.0;
+    JetSmear = 0.1;
+    LepSmear = 0.01;
+    METSmear = 10.0;
+    BTagEff = 0.85;
+    BTagMistag = 0.1;
+    PileUp = 0.0;
+  }
+};
+
+// generated event
+struct ZSynthEvent
+{
+  int Channel; // 1 ee, 2 mumu, 3 emu, 0 other (one W decays into quarks)
+  TLorentzVector T, Tbar; // generated top and antitop
+  ZFourVector LepM, LepP; // lepton- and lepton+ (smeared)
+  int FlavM, FlavP; // flavours of lepton- and lepton+ (11 electron, 13 muon, 0 if W decays into quarks)
+  int NPileUp; // number of pile-up interactions
+  ZFourVector B, Bbar; // b and bbar jets (smeared)
+  ZJet Jets[ZTree::maxNjet]; // all jets (b, bbar and extra jets, ordered by pT)
+  int NJets; // number of jets
+  double MetX, MetY; // missing transverse energy
+};
+
+// four vector of TLorentzVector (see fourVector.h)
+inline ZFourVector SynthFourVector(const TLorentzVector& v)
+{
+  return ZFourVector(v.X(), v.Y(), v.Z(), v.E());
+}
+
+// smear momentum of v by relative resolution (direction and mass are kept),
+// the difference is subtracted from (metX, metY)
+inline ZFourVector SynthSmear(TRandom3& rnd, const TLorentzVector& v, const double resolution, double& metX, double& metY)
+{
+  double scale = rnd.Gaus(1.0, resolution);
+  if(scale < 0.1)
+    scale = 0.1;
+  ZFourVector s;
+  s.SetXYZM(scale * v.X(), scale * v.Y(), scale * v.Z(), v.M());
+  metX -= s.Px - v.X();
+  metY -= s.Py - v.Y();
+  return s;
+}
+
+// b-tagging discriminator: above 0.244 with provided probability
+inline double SynthBTagDiscr(TRandom3& rnd, const double prob)
+{
+  return (rnd.Rndm() < prob) ? rnd.Uniform(0.244, 1.0) : rnd.Uniform(0.0, 0.244);
+}
+
+// light jet (pT above ptMin, falling spectrum with provided slope, |eta| < 3)
+inline void SynthLightJet(TRandom3& rnd, const double ptMin, const double slope, const ZSynthSettings& settings, ZJet& jet)
+{
+  jet.P.SetPtEtaPhiM(ptMin + rnd.Exp(slope), rnd.Uniform(-3.0, 3.0), rnd.Uniform(-TMath::Pi(), TMath::Pi()), 5.0 + rnd.Exp(5.0));
+  jet.BTag = (SynthBTagDiscr(rnd, settings.BTagMistag) > 0.244);
+}
+
+// generate one ttbar event in provided channel (1 ee, 2 mumu, 3 emu, 0 other)
+void SynthTTbarEvent(TRandom3& rnd, const int channel, const ZSynthSettings& settings, ZSynthEvent& ev)
+{
+  ev.Channel = channel;
+  ev.NPileUp = (settings.PileUp > 0.0) ? rnd.Poisson(settings.PileUp) : 0;
+  // ttbar system: mass above threshold, transverse momentum and rapidity
+  const double mtt = 2 * kSynthMassTop + rnd.Exp(100.0);
+  const double pttt = rnd.Exp(25.0);
+  const double phitt = rnd.Uniform(0.0, 2 * TMath::Pi());
+  const double ytt = rnd.Gaus(0.0, 0.8);
+  const double mTtt = TMath::Sqrt(mtt * mtt + pttt * pttt);
+  TLorentzVector ttbar;
+  ttbar.SetPxPyPzE(pttt * TMath::Cos(phitt), pttt * TMath::Sin(phitt), mTtt * TMath::SinH(ytt), mTtt * TMath::CosH(ytt));
+  // decays (flavours: emu with e+ mu- or mu+ e-; other: W+ or W- decays into quarks,
+  // the other one into electron or muon)
+  ev.FlavP = (channel == 1) ? 11 : 13;
+  ev.FlavM = (channel == 2) ? 13 : 11;
+  if((channel == 3 || channel == 0) && rnd.Rndm() < 0.5)
+  {
+    ev.FlavP = 11;
+    ev.FlavM = 13;
+  }
+  if(channel == 0)
+  {
+    if(rnd.Rndm() < 0.5)
+      ev.FlavP = 0;
+    else
+      ev.FlavM = 0;
+  }
+  const double massLP = (ev.FlavP == 11) ? massEl : ((ev.FlavP == 13) ? massMu : 0.0);
+  const double massLM = (ev.FlavM == 11) ? massEl : ((ev.FlavM == 13) ? massMu : 0.0);
+  TLorentzVector b, bbar, wp, wm, lp, lm, nu, nubar;
+  Decay(ttbar, kSynthMassTop, kSynthMassTop, rnd.Rndm(), rnd.Rndm(), ev.T, ev.Tbar);
+  Decay(ev.T, kSynthMassB, kSynthMassW, rnd.Rndm(), rnd.Rndm(), b, wp);
+  Decay(ev.Tbar, kSynthMassB, kSynthMassW, rnd.Rndm(), rnd.Rndm(), bbar, wm);
+  // (for W decaying into quarks, lepton and neutrino are the two quarks)
+  Decay(wp, massLP, 0.0, rnd.Rndm(), rnd.Rndm(), lp, nu);
+  Decay(wm, massLM, 0.0, rnd.Rndm(), rnd.Rndm(), lm, nubar);
+  // missing transverse energy from neutrinos, smeared objects
+  ev.MetX = ev.MetY = 0.0;
+  ev.NJets = 0;
+  if(ev.FlavP)
+  {
+    ev.MetX += nu.X();
+    ev.MetY += nu.Y();
+    ev.LepP = SynthSmear(rnd, lp, settings.LepSmear, ev.MetX, ev.MetY);
+  }
+  else
+    ev.LepP = ZFourVector(0.0, 0.0, 0.0, 0.0);
+  if(ev.FlavM)
+  {
+    ev.MetX += nubar.X();
+    ev.MetY += nubar.Y();
+    ev.LepM = SynthSmear(rnd, lm, settings.LepSmear, ev.MetX, ev.MetY);
+  }
+  else
+    ev.LepM = ZFourVector(0.0, 0.0, 0.0, 0.0);
+  ev.B = SynthSmear(rnd, b, settings.JetSmear, ev.MetX, ev.MetY);
+  ev.Bbar = SynthSmear(rnd, bbar, settings.JetSmear, ev.MetX, ev.MetY);
+  // resolution of missing transverse energy increases with pile-up
+  const double metSmear = TMath::Sqrt(settings.METSmear * settings.METSmear + 4.0 * ev.NPileUp);
+  // jets: b, bbar, quarks from W, extra jets (pT > 20 GeV) and pile-up jets, ordered by pT
+  ev.Jets[ev.NJets].P = ev.B;
+  ev.Jets[ev.NJets++].BTag = (SynthBTagDiscr(rnd, settings.BTagEff) > 0.244);
+  ev.Jets[ev.NJets].P = ev.Bbar;
+  ev.Jets[ev.NJets++].BTag = (SynthBTagDiscr(rnd, settings.BTagEff) > 0.244);
+  const TLorentzVector* quarks[4] = { ev.FlavP ? NULL : &lp, ev.FlavP ? NULL : &nu, ev.FlavM ? NULL : &lm, ev.FlavM ? NULL : &nubar };
+  for(int q = 0; q < 4; q++)
+  {
+    if(!quarks[q])
+      continue;
+    ZJet& jet = ev.Jets[ev.NJets++];
+    jet.P = SynthSmear(rnd, *quarks[q], settings.JetSmear, ev.MetX, ev.MetY);
+    jet.BTag = (SynthBTagDiscr(rnd, settings.BTagMistag) > 0.244);
+  }
+  ev.MetX += rnd.Gaus(0.0, metSmear);
+  ev.MetY += rnd.Gaus(0.0, metSmear);
+  const int nExtra = rnd.Poisson(settings.NExtraJets);
+  for(int j = 0; j < nExtra && ev.NJets < ZTree::maxNjet; j++)
+    SynthLightJet(rnd, 20.0, 25.0, settings, ev.Jets[ev.NJets++]);
+  const int nPileUpJets = ev.NPileUp ? rnd.Poisson(0.1 * ev.NPileUp) : 0;
+  for(int j = 0; j < nPileUpJets && ev.NJets < ZTree::maxNjet; j++)
+    SynthLightJet(rnd, 20.0, 5.0, settings, ev.Jets[ev.NJets++]);
+  for(int j = 1; j < ev.NJets; j++)
+    for(int k = j; k > 0 && ev.Jets[k].P.Pt() > ev.Jets[k - 1].P.Pt(); k--)
+      std::swap(ev.Jets[k], ev.Jets[k - 1]);
+}
+
+// set ntuple variables of tree from provided event (run and event numbers as provided):
+// leptons and jets of the event, extra leptons, missing transverse energy, primary
+// vertex, trigger bits of the channel and MC truth; all branches are marked as read
+// (see ZTree::SetLoaded())
+void SynthFillTree(TRandom3& rnd, const ZSynthEvent& ev, const ZSynthSettings& settings, const int run, const int event, ZTree* tree)
+{
+  tree->evRunNumber = run;
+  tree->evEventNumber = event;
+  // leptons of the ttbar decay (isolated, pT with the sign of the charge), then extra leptons
+  tree->Nel = tree->Nmu = 0;
+  const int nExtra = rnd.Poisson(settings.NExtraLep);
+  for(int l = 0; l < 2 + nExtra; l++)
+  {
+    int flav = 0;
+    double charge = 0.0, pt = 0.0, eta = 0.0, phi = 0.0, iso = 0.0;
+    // (lepton of W decaying into quarks does not exist)
+    if(l < 2 && !((l == 0) ? ev.FlavP : ev.FlavM))
+      continue;
+    if(l < 2)
+    {
+      const TLorentzVector p = ((l == 0) ? ev.LepP : ev.LepM).LorentzVector();
+      flav = (l == 0) ? ev.FlavP : ev.FlavM;
+      charge = (l == 0) ? 1.0 : -1.0;
+      pt = p.Pt();
+      eta = p.Eta();
+      phi = p.Phi();
+      iso = rnd.Exp(0.03);
+    }
+    else
+    {
+      flav = (rnd.Rndm() < 0.5) ? 11 : 13;
+      charge = (rnd.Rndm() < 0.5) ? 1.0 : -1.0;
+      pt = 5.0 + rnd.Exp(10.0);
+      eta = rnd.Uniform(-2.5, 2.5);
+      phi = rnd.Uniform(-TMath::Pi(), TMath::Pi());
+      iso = rnd.Exp(0.5);
+    }
+    // pile-up energy in the isolation cone
+    if(ev.NPileUp > 0)
+      iso += rnd.Exp(0.002 * ev.NPileUp);
+    if(flav == 11 && tree->Nel < ZTree::maxNel)
+    {
+      const int el = tree->Nel++;
+      tree->elPt[el] = charge * pt;
+      tree->elEta[el] = eta;
+      tree->elPhi[el] = phi;
+      tree->elIso03[el] = iso;
+      tree->elIso04[el] = 1.3 * iso;
+      tree->elConvFlag[el] = 0;
+      tree->elConvDist[el] = rnd.Uniform(0.0, 0.5);
+      tree->elConvDcot[el] = rnd.Uniform(0.0, 0.5);
+      tree->elMissHits[el] = (rnd.Rndm() < 0.95) ? 0 : 1;
+    }
+    else if(flav == 13 && tree->Nmu < ZTree::maxNmu)
+    {
+      const int mu = tree->Nmu++;
+      tree->muPt[mu] = charge * pt;
+      tree->muEta[mu] = eta;
+      tree->muPhi[mu] = phi;
+      tree->muIso03[mu] = iso;
+      tree->muIso04[mu] = 1.3 * iso;
+      tree->muHitsValid[mu] = 10 + rnd.Poisson(8.0);
+      tree->muHitsPixel[mu] = 1 + rnd.Poisson(2.0);
+      tree->muDistPV0[mu] = TMath::Abs(rnd.Gaus(0.0, 0.005));
+      tree->muDistPVz[mu] = TMath::Abs(rnd.Gaus(0.0, 0.05));
+      tree->muTrackChi2NDOF[mu] = rnd.Exp(1.5);
+    }
+  }
+  // jets (b-tagging flags of the event are kept)
+  tree->Njet = ev.NJets;
+  for(int j = 0; j < ev.NJets; j++)
+  {
+    const TLorentzVector p = ev.Jets[j].P.LorentzVector();
+    tree->jetPt[j] = p.Pt();
+    tree->jetEta[j] = p.Eta();
+    tree->jetPhi[j] = p.Phi();
+    tree->jetMass[j] = p.M();
+    tree->jetMuEn[j] = 0.0;
+    tree->jetElEn[j] = 0.0;
+    tree->jetBTagDiscr[j] = ev.Jets[j].BTag ? rnd.Uniform(0.244, 1.0) : rnd.Uniform(0.0, 0.244);
+    tree->jetBTagMatchDiff1[j] = rnd.Exp(0.05);
+    tree->jetBTagMatchDiff2[j] = tree->jetBTagMatchDiff1[j] + rnd.Exp(0.2);
+  }
+  tree->metPx = ev.MetX;
+  tree->metPy = ev.MetY;
+  // primary vertices (signal and pile-up)
+  tree->Npv = 1 + ev.NPileUp;
+  tree->pvNDOF = 4 + rnd.Poisson(60.0);
+  tree->pvZ = rnd.Gaus(0.0, 6.0);
+  tree->pvRho = TMath::Abs(rnd.Gaus(0.0, 0.05));
+  // trigger bits of the channel (see TriggerMask() in selection.h), each fired with 95% probability
+  // (other events: each bit with 5% probability)
+  tree->Triggers = 0;
+  for(int bit = 0; bit < 6; bit++)
+  {
+    const bool channelBit = ev.Channel && (TriggerMask(ev.Channel) & (1 << bit));
+    if(rnd.Rndm() < (channelBit ? 0.95 : (ev.Channel ? 0.0 : 0.05)))
+      tree->Triggers |= 1 << bit;
+  }
+  // MC truth
+  tree->mcEventType = ev.Channel;
+  const TLorentzVector* top[2] = { &ev.T, &ev.Tbar };
+  float* mc[2] = { tree->mcT, tree->mcTbar };
+  for(int i = 0; i < 2; i++)
+  {
+    mc[i][0] = top[i]->X();
+    mc[i][1] = top[i]->Y();
+    mc[i][2] = top[i]->Z();
+    mc[i][3] = top[i]->M();
+  }
+  tree->SetLoaded(kReadSetAll);
+}
+
+// create branches of output tree with the layout of the ntuples written
+// by Analyzer (see Analyzer/src/Analyzer.cc), only the branches read by
+// ZTree (see tree.h); branch addresses are the variables of provided ZTree
+// (fill them with SynthFillTree() before TTree::Fill())
+void SynthBookBranches(TTree* out, ZTree* tree, const bool flagMC)
+{
+  out->Branch("evRunNumber", &tree->evRunNumber, "evRunNumber/I");
+  out->Branch("evEventNumber", &tree->evEventNumber, "evEventNumber/I");
+  // muons
+  out->Branch("Nmu", &tree->Nmu, "Nmu/I");
+  out->Branch("muPt", tree->muPt, "muPt[Nmu]/F");
+  out->Branch("muEta", tree->muEta, "muEta[Nmu]/F");
+  out->Branch("muPhi", tree->muPhi, "muPhi[Nmu]/F");
+  out->Branch("muIso03", tree->muIso03, "muIso03[Nmu]/F");
+  out->Branch("muIso04", tree->muIso04, "muIso04[Nmu]/F");
+  out->Branch("muHitsValid", tree->muHitsValid, "muHitsValid[Nmu]/I");
+  out->Branch("muHitsPixel", tree->muHitsPixel, "muHitsPixel[Nmu]/I");
+  out->Branch("muDistPV0", tree->muDistPV0, "muDistPV0[Nmu]/F");
+  out->Branch("muDistPVz", tree->muDistPVz, "muDistPVz[Nmu]/F");
+  out->Branch("muTrackChi2NDOF", tree->muTrackChi2NDOF, "muTrackChi2NDOF[Nmu]/F");
+  // electrons
+  out->Branch("Nel", &tree->Nel, "Nel/I");
+  out->Branch("elPt", tree->elPt, "elPt[Nel]/F");
+  out->Branch("elEta", tree->elEta, "elEta[Nel]/F");
+  out->Branch("elPhi", tree->elPhi, "elPhi[Nel]/F");
+  out->Branch("elIso03", tree->elIso03, "elIso03[Nel]/F");
+  out->Branch("elIso04", tree->elIso04, "elIso04[Nel]/F");
+  out->Branch("elConvFlag", tree->elConvFlag, "elConvFlag[Nel]/I");
+  out->Branch("elConvDist", tree->elConvDist, "elConvDist[Nel]/F");
+  out->Branch("elConvDcot", tree->elConvDcot, "elConvDcot[Nel]/F");
+  out->Branch("elMissHits", tree->elMissHits, "elMissHits[Nel]/F");
+  // jets
+  out->Branch("Njet", &tree->Njet, "Njet/I");
+  out->Branch("jetPt", tree->jetPt, "jetPt[Njet]/F");
+  out->Branch("jetEta", tree->jetEta, "jetEta[Njet]/F");
+  out->Branch("jetPhi", tree->jetPhi, "jetPhi[Njet]/F");
+  out->Branch("jetMass", tree->jetMass, "jetMass[Njet]/F");
+  out->Branch("jetMuEn", tree->jetMuEn, "jetMuEn[Njet]/F");
+  out->Branch("jetElEn", tree->jetElEn, "jetElEn[Njet]/F");
+  out->Branch("jetBTagDiscr", tree->jetBTagDiscr, "jetBTagDiscr[Njet]/F");
+  out->Branch("jetBTagMatchDiff1", tree->jetBTagMatchDiff1, "jetBTagMatchDiff1[Njet]/F");
+  out->Branch("jetBTagMatchDiff2", tree->jetBTagMatchDiff2, "jetBTagMatchDiff2[Njet]/F");
+  // missing transverse energy, triggers, primary vertex
+  out->Branch("metPx", &tree->metPx, "metPx/F");
+  out->Branch("metPy", &tree->metPy, "metPy/F");
+  out->Branch("Triggers", &tree->Triggers, "Triggers/I");
+  out->Branch("Npv", &tree->Npv, "Npv/I");
+  out->Branch("pvNDOF", &tree->pvNDOF, "pvNDOF/I");
+  out->Branch("pvZ", &tree->pvZ, "pvZ/F");
+  out->Branch("pvRho", &tree->pvRho, "pvRho/F");
+  // MC truth
+  if(flagMC)
+  {
+    out->Branch("mcEventType", &tree->mcEventType, "mcEventType/I");
+    out->Branch("mcT", tree->mcT, "mcT[4]/F");
+    out->Branch("mcTbar", tree->mcTbar, "mcTbar[4]/F");
+  }
+}
+
+#endif
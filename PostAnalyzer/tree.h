@@ -8,6 +8,40 @@
 
 #include <TROOT.h>
 #include <TChain.h>
+#include "profile.h"
+
+// Branch identifiers: bit numbers in read-set masks
+// (order follows ZTree variables, see below)
+enum EZTreeBranch
+{
+  kBrEvRunNumber, kBrEvEventNumber,
+  kBrNmu, kBrMuPt, kBrMuEta, kBrMuPhi, kBrMuIso03, kBrMuIso04, kBrMuHitsValid, kBrMuHitsPixel, kBrMuDistPV0, kBrMuDistPVz, kBrMuTrackChi2NDOF,
+  kBrNel, kBrElPt, kBrElEta, kBrElPhi, kBrElIso03, kBrElIso04, kBrElConvFlag, kBrElConvDist, kBrElConvDcot, kBrElMissHits,
+  kBrNjet, kBrJetPt, kBrJetEta, kBrJetPhi, kBrJetMass, kBrJetMuEn, kBrJetElEn, kBrJetBTagDiscr, kBrJetBTagMatchDiff1, kBrJetBTagMatchDiff2,
+  kBrMetPx, kBrMetPy, kBrNpv, kBrPvNDOF, kBrPvZ, kBrPvRho, kBrTriggers,
+  kBrMcEventType, kBrMcT, kBrMcTbar, // MC only
+  kBrNBranches // total number of branches
+};
+
+// Read-set: set of branches which are read (bit mask, bit numbers are EZTreeBranch)
+typedef ULong64_t ZReadSet;
+
+// read-set with one branch
+constexpr ZReadSet ZBranchBit(const int br) { return (1ULL << br); }
+
+// read-set with all branches
+const ZReadSet kReadSetAll = ZBranchBit(kBrNBranches) - 1;
+
+// Code reading ntuple variables declares which branches it needs by 
+// ZTREE_REQUIRE(tree, readSet, where): if compiled with -DZTREE_DEBUG, 
+// this stops the program if some of these branches are not active 
+// (i.e. their variables would contain values from other events), 
+// otherwise it does nothing.
+#ifdef ZTREE_DEBUG
+#define ZTREE_REQUIRE(tree, readSet, where) (tree)->Require((readSet), (where))
+#else
+#define ZTREE_REQUIRE(tree, readSet, where)
+#endif
 
 // Class which gives access to all information in each event stored in ntuples
 class ZTree {
@@ -126,15 +160,132 @@ public :
 
    // constructor
    // argument: true for MC, false (default) for data
-   ZTree(bool flagMC = false) : fChain(0), _flagMC(flagMC) { }
+   ZTree(bool flagMC = false) : fChain(0), _flagMC(flagMC), _readSet(kReadSetAll), _loaded(0), _localEntry(-1) { }
    
    // destructor
    virtual ~ZTree() { }
    
    // initialise with provided tree pointer
    virtual void    Init(TTree *tree);
+
+   // branch name (argument is EZTreeBranch)
+   static const char* BranchName(const int br);
+
+   // activate only branches in provided read-set (all other branches are not read)
+   void SetReadSet(const ZReadSet readSet);
+
+   // currently active branches
+   ZReadSet ReadSet() const { return _readSet; }
+
+   // read all active branches for given entry
+   int GetEntry(const Long64_t entry);
+
+   // Staged reading: prepare given entry without reading any branch, 
+   // returns false if there is no such entry; after this, the active 
+   // branches are read by Load() calls only when they are needed 
+   // (e.g. jets only for events which passed the lepton selection)
+   bool LoadEntry(const Long64_t entry);
+
+   // current entry in the current tree of the chain (see LoadEntry())
+   Long64_t LocalEntry() const { return _localEntry; }
+
+   // mark branches in provided read-set as read for the current entry
+   // (for variables which are set directly, e.g. synthetic events, see synthEvent.h)
+   void SetLoaded(const ZReadSet readSet) { _loaded = readSet; }
+
+   // read branches in provided read-set for the current entry (see LoadEntry()), 
+   // branches which are inactive or already read are skipped
+   void Load(const ZReadSet readSet)
+   {
+      ZReadSet toLoad = readSet & _readSet & ~_loaded;
+      if(!toLoad)
+         return;
+      ZPROFILE_SCOPE(kProfRead);
+      for(int br = 0; br < kBrNBranches; br++)
+         if(toLoad & ZBranchBit(br))
+            (*_branch[br])->GetEntry(_localEntry);
+      _loaded |= toLoad;
+   }
+
+   // stop if some branches in provided read-set are not active or not read 
+   // for the current entry (see ZTREE_REQUIRE above), 
+   // where is the name of the calling routine (to be printed)
+   void Require(const ZReadSet readSet, const char* where) const;
+
+private :
+   // active branches
+   ZReadSet _readSet;
+   // branches read for the current entry
+   ZReadSet _loaded;
+   // current entry in the current tree of the chain
+   Long64_t _localEntry;
+   // branch pointers by EZTreeBranch
+   TBranch** _branch[kBrNBranches];
 };
 
+// branch name (argument is EZTreeBranch)
+const char* ZTree::BranchName(const int br)
+{
+   static const char* names[kBrNBranches] = {
+      "evRunNumber", "evEventNumber",
+      "Nmu", "muPt", "muEta", "muPhi", "muIso03", "muIso04", "muHitsValid", "muHitsPixel", "muDistPV0", "muDistPVz", "muTrackChi2NDOF",
+      "Nel", "elPt", "elEta", "elPhi", "elIso03", "elIso04", "elConvFlag", "elConvDist", "elConvDcot", "elMissHits",
+      "Njet", "jetPt", "jetEta", "jetPhi", "jetMass", "jetMuEn", "jetElEn", "jetBTagDiscr", "jetBTagMatchDiff1", "jetBTagMatchDiff2",
+      "metPx", "metPy", "Npv", "pvNDOF", "pvZ", "pvRho", "Triggers",
+      "mcEventType", "mcT", "mcTbar"
+   };
+   return names[br];
+}
+
+// activate only branches in provided read-set
+void ZTree::SetReadSet(const ZReadSet readSet)
+{
+   fChain->SetBranchStatus("*", 0);
+   _readSet = 0;
+   for(int br = 0; br < kBrNBranches; br++)
+   {
+      if(!(readSet & ZBranchBit(br)))
+         continue;
+      // MC branches do not exist in data
+      if(!_flagMC && br >= kBrMcEventType)
+         continue;
+      fChain->SetBranchStatus(BranchName(br), 1);
+      _readSet |= ZBranchBit(br);
+   }
+}
+
+// read all active branches for given entry
+int ZTree::GetEntry(const Long64_t entry)
+{
+   ZPROFILE_SCOPE(kProfRead);
+   int nbytes = fChain->GetEntry(entry);
+   _loaded = _readSet;
+   return nbytes;
+}
+
+// prepare given entry for staged reading
+bool ZTree::LoadEntry(const Long64_t entry)
+{
+   ZPROFILE_SCOPE(kProfRead);
+   _loaded = 0;
+   _localEntry = fChain->LoadTree(entry);
+   return (_localEntry >= 0);
+}
+
+// stop if some branches in provided read-set are not active or not read
+void ZTree::Require(const ZReadSet readSet, const char* where) const
+{
+   ZReadSet missing = readSet & ~_loaded;
+   if(!missing)
+      return;
+   printf("Error in %s: reading inactive or not loaded branches:", where);
+   for(int br = 0; br < kBrNBranches; br++)
+      if(missing & ZBranchBit(br))
+         printf(" %s", BranchName(br));
+   printf("\n");
+   exit(1);
+}
+
 // initialise with provided tree pointer
 void ZTree::Init(TTree *tree)
 {
@@ -187,6 +338,50 @@ void ZTree::Init(TTree *tree)
    if(_flagMC) fChain->SetBranchAddress("mcEventType", &mcEventType, &b_mcEventType);
    if(_flagMC) fChain->SetBranchAddress("mcT", mcT, &b_mcT);
    if(_flagMC) fChain->SetBranchAddress("mcTbar", mcTbar, &b_mcTbar);
+   // branch pointers by EZTreeBranch (for reading of single branches, see Load())
+   _branch[kBrEvRunNumber] = &b_evRunNumber;
+   _branch[kBrEvEventNumber] = &b_evEventNumber;
+   _branch[kBrNmu] = &b_Nmu;
+   _branch[kBrMuPt] = &b_muPt;
+   _branch[kBrMuEta] = &b_muEta;
+   _branch[kBrMuPhi] = &b_muPhi;
+   _branch[kBrMuIso03] = &b_muIso03;
+   _branch[kBrMuIso04] = &b_muIso04;
+   _branch[kBrMuHitsValid] = &b_muHitsValid;
+   _branch[kBrMuHitsPixel] = &b_muHitsPixel;
+   _branch[kBrMuDistPV0] = &b_muDistPV0;
+   _branch[kBrMuDistPVz] = &b_muDistPVz;
+   _branch[kBrMuTrackChi2NDOF] = &b_muTrackChi2NDOF;
+   _branch[kBrNel] = &b_Nel;
+   _branch[kBrElPt] = &b_elPt;
+   _branch[kBrElEta] = &b_elEta;
+   _branch[kBrElPhi] = &b_elPhi;
+   _branch[kBrElIso03] = &b_elIso03;
+   _branch[kBrElIso04] = &b_elIso04;
+   _branch[kBrElConvFlag] = &b_elConvFlag;
+   _branch[kBrElConvDist] = &b_elConvDist;
+   _branch[kBrElConvDcot] = &b_elConvDcot;
+   _branch[kBrElMissHits] = &b_elMissHits;
+   _branch[kBrNjet] = &b_Njet;
+   _branch[kBrJetPt] = &b_jetPt;
+   _branch[kBrJetEta] = &b_jetEta;
+   _branch[kBrJetPhi] = &b_jetPhi;
+   _branch[kBrJetMass] = &b_jetMass;
+   _branch[kBrJetMuEn] = &b_jetMuEn;
+   _branch[kBrJetElEn] = &b_jetElEn;
+   _branch[kBrJetBTagDiscr] = &b_jetBTagDiscr;
+   _branch[kBrJetBTagMatchDiff1] = &b_jetBTagMatchDiff1;
+   _branch[kBrJetBTagMatchDiff2] = &b_jetBTagMatchDiff2;
+   _branch[kBrMetPx] = &b_metPx;
+   _branch[kBrMetPy] = &b_metPy;
+   _branch[kBrNpv] = &b_Npv;
+   _branch[kBrPvNDOF] = &b_pvNDOF;
+   _branch[kBrPvZ] = &b_pvZ;
+   _branch[kBrPvRho] = &b_pvRho;
+   _branch[kBrTriggers] = &b_Triggers;
+   _branch[kBrMcEventType] = &b_mcEventType;
+   _branch[kBrMcT] = &b_mcT;
+   _branch[kBrMcTbar] = &b_mcTbar;
 }
 
 #endif // #ifdef ZTree_h
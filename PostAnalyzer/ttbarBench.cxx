@@ -0,0 +1,289 @@
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// This code benchmarks the kinematic reconstruction (see kinReco.h)
+// on recorded input: run ./ttbarMakeHist with the record file name
+// as the second argument (e.g. ./ttbarMakeHist 1 kinreco.dat), this
+// writes input of every SolveKinRecoDilepton() call, then run
+// ./ttbarBench kinreco.dat [maximum number of records]
+// The closed-form quartic solver (quartic.h) is compared to
+// ROOT::Math::Polynomial: speed, numbers of roots, root values,
+// kinreco inaccuracy distribution (hInacc) and the best solutions; 
+// batched kinreco (kinRecoBatch.h) is compared to event by event one, 
+// and tabulated neutrino weights (landau.h) to TMath::Landau().
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// additional files from this analysis (look there for description)
+#include "kinReco.h"
+#include "kinRecoBatch.h"
+// C++ library or ROOT header files
+#include <TStopwatch.h>
+
+// names of solvers (see EKinRecoQuartic in kinReco.h)
+const char* gQuarticName[2] = { "analytic", "ROOT" };
+
+// input four momentum from record
+ZFourVector RecordVector(const double* v)
+{
+  return ZFourVector(v[0], v[1], v[2], v[3]);
+}
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>> Quartic roots >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// compare speed and roots of quartic equation solvers
+void BenchQuartic(const std::vector<ZKinRecoRecord>& vecRec)
+{
+  const int nRec = vecRec.size();
+  std::vector<double> vecRoots[2];
+  std::vector<int> vecN[2];
+  for(int solver = 0; solver < 2; solver++)
+  {
+    vecRoots[solver].resize(4 * nRec);
+    vecN[solver].resize(nRec);
+    TStopwatch timer;
+    for(int r = 0; r < nRec; r++)
+      vecN[solver][r] = KinRecoQuarticRoots(vecRec[r].Pars, &vecRoots[solver][4 * r], solver);
+    timer.Stop();
+    printf("quartic %-10s: %8.1f ns/call\n", gQuarticName[solver], 1e9 * timer.RealTime() / nRec);
+  }
+  // numbers of roots and root values (roots of ROOT solver are not ordered)
+  long nSameN = 0;
+  long nMoreAnalytic = 0;
+  long nMoreROOT = 0;
+  double maxDiff = 0.0;
+  double maxResidual[2] = { 0.0, 0.0 };
+  for(int r = 0; r < nRec; r++)
+  {
+    double* roots[2] = { &vecRoots[0][4 * r], &vecRoots[1][4 * r] };
+    std::sort(roots[1], roots[1] + vecN[1][r]);
+    // residual relative to the largest term of polynomial
+    for(int solver = 0; solver < 2; solver++)
+      for(int s = 0; s < vecN[solver][r]; s++)
+      {
+        const double x = roots[solver][s];
+        double scale = 0.0;
+        for(int p = 0; p < 5; p++)
+          scale = std::max(scale, TMath::Abs(vecRec[r].Pars[p] * TMath::Power(x, p)));
+        if(scale > 0.0)
+          maxResidual[solver] = std::max(maxResidual[solver], TMath::Abs(EvalPolynomial(vecRec[r].Pars, 4, x)) / scale);
+      }
+    if(vecN[0][r] != vecN[1][r])
+    {
+      if(vecN[0][r] > vecN[1][r])
+        nMoreAnalytic++;
+      else
+        nMoreROOT++;
+      continue;
+    }
+    nSameN++;
+    for(int s = 0; s < vecN[0][r]; s++)
+      maxDiff = std::max(maxDiff, TMath::Abs(roots[0][s] - roots[1][s]) / std::max(1.0, TMath::Abs(roots[1][s])));
+  }
+  printf("same number of roots: %ld of %d (%.4f%%), more roots: analytic %ld, ROOT %ld\n",
+    nSameN, nRec, 100.0 * nSameN / nRec, nMoreAnalytic, nMoreROOT);
+  printf("max relative root difference (same number of roots): %e\n", maxDiff);
+  printf("max relative residual: analytic %e, ROOT %e\n", maxResidual[0], maxResidual[1]);
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>> Full solution >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// compare speed, inaccuracy and solutions of SolveKinRecoDilepton() with both solvers
+void BenchSolve(const std::vector<ZKinRecoRecord>& vecRec)
+{
+  const int nRec = vecRec.size();
+  std::vector<ZSolutionKinRecoDilepton> vecSol[2];
+  std::vector<bool> vecSolved[2];
+  TH1D* hInacc[2];
+  for(int solver = 0; solver < 2; solver++)
+  {
+    gKinRecoQuartic = solver;
+    vecSol[solver].resize(nRec);
+    vecSolved[solver].resize(nRec);
+    // the same binning as in eventreco() (see eventReco.h)
+    hInacc[solver] = new TH1D(TString::Format("hInacc%d", solver), "KinReco inaccuracy", 1000, 0.0, 100.0);
+    hInacc[solver]->SetDirectory(0);
+    TStopwatch timer;
+    for(int r = 0; r < nRec; r++)
+    {
+      const ZKinRecoRecord& rec = vecRec[r];
+      vecSolved[solver][r] = SolveKinRecoDilepton(RecordVector(rec.Lm), RecordVector(rec.Lp), RecordVector(rec.B), RecordVector(rec.Bbar),
+                                                  rec.MetX, rec.MetY, vecSol[solver][r], hInacc[solver]);
+    }
+    timer.Stop();
+    printf("SolveKinRecoDilepton %-10s: %8.1f ns/call\n", gQuarticName[solver], 1e9 * timer.RealTime() / nRec);
+  }
+  // inaccuracy distributions
+  const int nq = 4;
+  double prob[nq] = { 0.5, 0.9, 0.99, 0.999 };
+  for(int solver = 0; solver < 2; solver++)
+  {
+    double q[nq];
+    hInacc[solver]->GetQuantiles(nq, q, prob);
+    printf("inaccuracy %-10s: entries %.0f  mean %e  quantiles 50%% %e  90%% %e  99%% %e  99.9%% %e  overflow %.0f\n",
+      gQuarticName[solver], hInacc[solver]->GetEntries(), hInacc[solver]->GetMean(), q[0], q[1], q[2], q[3], hInacc[solver]->GetBinContent(1001));
+  }
+  // best solutions
+  long nSameStatus = 0;
+  long nSameSol = 0;
+  long nBothSolved = 0;
+  for(int r = 0; r < nRec; r++)
+  {
+    if(vecSolved[0][r] != vecSolved[1][r])
+      continue;
+    nSameStatus++;
+    if(!vecSolved[0][r])
+      continue;
+    nBothSolved++;
+    const TLorentzVector diff = (vecSol[0][r].zT - vecSol[1][r].zT).LorentzVector();
+    const TLorentzVector diffBar = (vecSol[0][r].zTbar - vecSol[1][r].zTbar).LorentzVector();
+    if(diff.P() < 1e-6 * vecSol[1][r].zT.LorentzVector().P() && diffBar.P() < 1e-6 * vecSol[1][r].zTbar.LorentzVector().P())
+      nSameSol++;
+  }
+  printf("same status: %ld of %d (%.4f%%), same best solution (1e-6): %ld of %ld (%.4f%%)\n",
+    nSameStatus, nRec, 100.0 * nSameStatus / nRec, nSameSol, nBothSolved, (nBothSolved > 0) ? (100.0 * nSameSol / nBothSolved) : 0.0);
+  delete hInacc[0];
+  delete hInacc[1];
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>> Batched kinreco >>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// compare speed and results of KinRecoDilepton() (event by event) and ZKinRecoBatch 
+// (blocks of provided number of events); each record is used as an event with two 
+// jets (b and bbar of the record), i.e. with two jet pair hypotheses
+void BenchBatch(const std::vector<ZKinRecoRecord>& vecRec, const int block)
+{
+  const int nRec = vecRec.size();
+  std::vector<ZFourVector> vecT(nRec), vecTbar(nRec);
+  std::vector<int> vecStatus(nRec);
+  TStopwatch timerScalar;
+  for(int r = 0; r < nRec; r++)
+  {
+    const ZKinRecoRecord& rec = vecRec[r];
+    ZJet jets[2] = { { RecordVector(rec.B), false }, { RecordVector(rec.Bbar), false } };
+    vecStatus[r] = KinRecoDilepton(RecordVector(rec.Lm), RecordVector(rec.Lp), jets, 2, rec.MetX, rec.MetY, vecT[r], vecTbar[r]);
+  }
+  timerScalar.Stop();
+  long nSame = 0;
+  ZKinRecoBatch batch;
+  TStopwatch timerBatch;
+  timerBatch.Stop();
+  timerBatch.Reset();
+  for(int first = 0; first < nRec; first += block)
+  {
+    const int last = std::min(first + block, nRec);
+    timerBatch.Start(false);
+    for(int r = first; r < last; r++)
+    {
+      const ZKinRecoRecord& rec = vecRec[r];
+      ZJet jets[2] = { { RecordVector(rec.B), false }, { RecordVector(rec.Bbar), false } };
+      batch.AddEvent(RecordVector(rec.Lm), RecordVector(rec.Lp), jets, 2, rec.MetX, rec.MetY);
+    }
+    batch.Solve();
+    timerBatch.Stop();
+    for(int r = first; r < last; r++)
+    {
+      const int ev = r - first;
+      if(batch.Status(ev) == vecStatus[r] && (!vecStatus[r] || (batch.T(ev) == vecT[r] && batch.Tbar(ev) == vecTbar[r])))
+        nSame++;
+    }
+    batch.Clear();
+  }
+  printf("KinRecoDilepton: %8.1f ns/event, ZKinRecoBatch (block %d): %8.1f ns/event\n", 
+    1e9 * timerScalar.RealTime() / nRec, block, 1e9 * timerBatch.RealTime() / nRec);
+  printf("identical results: %ld of %d (%.4f%%)\n", nSame, nRec, 100.0 * nSame / nRec);
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>> Neutrino weights >>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// compare speed of exact and tabulated Landau weights (on neutrino energies 
+// of best solutions) and best solutions of SolveKinRecoDilepton() with both
+void BenchLandau(const std::vector<ZKinRecoRecord>& vecRec)
+{
+  const int nRec = vecRec.size();
+  const char* name[2] = { "exact", "table" };
+  // build table before timing
+  KinRecoLandauTable();
+  // neutrino energies of best solutions with exact weights, and best solutions
+  std::vector<double> vecE;
+  std::vector<ZSolutionKinRecoDilepton> vecSol[2];
+  std::vector<bool> vecSolved[2];
+  for(int landau = 0; landau < 2; landau++)
+  {
+    vecSol[landau].resize(nRec);
+    vecSolved[landau].resize(nRec);
+    TStopwatch timer;
+    for(int r = 0; r < nRec; r++)
+    {
+      const ZKinRecoRecord& rec = vecRec[r];
+      const ZFourVector lm = RecordVector(rec.Lm);
+      const ZFourVector lp = RecordVector(rec.Lp);
+      const ZFourVector b = RecordVector(rec.B);
+      const ZFourVector bbar = RecordVector(rec.Bbar);
+      vecSolved[landau][r] = SolveKinRecoDilepton(lm, lp, b, bbar, rec.MetX, rec.MetY, vecSol[landau][r], NULL, NULL, landau);
+      if(landau == 0 && vecSolved[landau][r])
+      {
+        vecE.push_back((vecSol[landau][r].zT - lp - b).E);
+        vecE.push_back((vecSol[landau][r].zTbar - lm - bbar).E);
+      }
+    }
+    timer.Stop();
+    printf("SolveKinRecoDilepton Landau %s: %8.1f ns/call\n", name[landau], 1e9 * timer.RealTime() / nRec);
+  }
+  // weights only
+  const int nE = vecE.size();
+  double maxRelError = 0.0;
+  for(int landau = 0; landau < 2 && nE > 0; landau++)
+  {
+    double sum = 0.0;
+    TStopwatch timer;
+    for(int e = 0; e < nE; e++)
+      sum += KinRecoLandauWeight(vecE[e], landau);
+    timer.Stop();
+    printf("Landau weight %s: %8.2f ns/call (sum %e)\n", name[landau], 1e9 * timer.RealTime() / nE, sum);
+  }
+  for(int e = 0; e < nE; e++)
+  {
+    const double exact = KinRecoLandauWeight(vecE[e], kLandauExact);
+    if(exact > 0.0)
+      maxRelError = std::max(maxRelError, TMath::Abs(KinRecoLandauWeight(vecE[e], kLandauTable) / exact - 1.0));
+  }
+  printf("Landau table max relative error: %e (table), %e (neutrino energies)\n", KinRecoLandauTable().MaxRelError(), maxRelError);
+  // best solutions must be identical
+  long nSame = 0;
+  for(int r = 0; r < nRec; r++)
+    if(vecSolved[0][r] == vecSolved[1][r] && (!vecSolved[0][r] || 
+       (vecSol[0][r].zT == vecSol[1][r].zT && vecSol[0][r].zTbar == vecSol[1][r].zTbar)))
+      nSame++;
+  printf("identical best solutions: %ld of %d (%.4f%%)\n", nSame, nRec, 100.0 * nSame / nRec);
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>> Main function >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+int main(int argc, char** argv)
+{
+  if(argc < 2)
+  {
+    printf("Usage: %s <record file> [maximum number of records]\n", argv[0]);
+    return 1;
+  }
+  std::vector<ZKinRecoRecord> vecRec = KinRecoRecordRead(argv[1]);
+  if(argc > 2 && vecRec.size() > atol(argv[2]))
+    vecRec.resize(atol(argv[2]));
+  printf("records: %ld\n", vecRec.size());
+  if(vecRec.size() == 0)
+    return 0;
+  BenchQuartic(vecRec);
+  BenchSolve(vecRec);
+  gKinRecoQuartic = kQuarticAnalytic;
+  BenchBatch(vecRec, 256);
+  BenchLandau(vecRec);
+  return 0;
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
@@ -2,7 +2,7 @@
 // This code processes ROOT ntuples for ttbar analysis (see 
 // Analyzer/src/Analyzer.cc) and produces histograms, which are 
 // further used to make final plots (see ttbarMakePlots.cxx).
-// Run: ./ttbarMakeHist
+// Run: ./ttbarMakeHist [number of threads] [kinreco record file]
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 //
 // additional files from this analysis (look there for description) 
@@ -29,6 +29,31 @@ int main(int argc, char** argv)
   bool flagMCstop  = 1; // if 1, MC single top (background) will be processed
   bool flagMCdy    = 1; // if 1, MC Drell-Yan (background) will be processed
   //
+  // number of threads for event loops (1 for serial processing, 
+  // histogram bins do not depend on it), can be given as command line argument
+  int nThreads = 1;
+  if(argc > 1)
+    nThreads = atoi(argv[1]);
+  //
+  // optionally, input of kinematic reconstruction can be recorded to a file 
+  // given as the second command line argument (see ttbarBench.cxx)
+  if(argc > 2 && !KinRecoRecordOpen(argv[2]))
+    return 1;
+  //
+  // neutrino weights in kinematic reconstruction (see EKinRecoLandau in kinReco.h): 
+  // exact by default, tabulated ones are faster, validation mode checks that 
+  // tabulated weights do not change reconstructed events (the counters are printed at the end)
+  //gKinRecoLandau = kLandauTable;
+  //gKinRecoLandau = kLandauValidate;
+  //
+  // quartic equation solver in kinematic reconstruction (see EKinRecoQuartic in kinReco.h): 
+  // ROOT by default, the closed-form one is faster (compare them first with ttbarBench)
+  //gKinRecoQuartic = kQuarticAnalytic;
+  //
+  // pruning of jet pairs in kinematic reconstruction (see KinRecoDileptonPruned() in kinReco.h), 
+  // results do not depend on it, the number of avoided solver calls is printed for each event loop
+  //gKinRecoPrune = true;
+  //
   // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
   //
   
@@ -73,47 +98,42 @@ int main(int argc, char** argv)
     vecVHGen.push_back(ZVarHisto("mtt", new TH1D("h_mtt_cs", "M ttbar", 7, bins)));
   }
   // histograms and variables for double-differential cross sections
+  // (2D histograms, stored as 1D histograms for each bin of the second variable, see ZVarHisto)
   {
     // [yt,ptt]
     std::vector<double> bins_yt = {0.,0.35,0.85,1.45,2.50};
     std::vector<double> bins_ptt = {0.,80,150.,250.,600.};
-    for(int i = 0; i < bins_yt.size() - 1; i++)
-      vecVHGen.push_back(ZVarHisto("ptt", new TH1D(TString::Format("h_ytptt%d_cs", i + 1), "y top, pT top", bins_ptt.size() - 1, &bins_ptt[0]), "ayt", bins_yt[i], bins_yt[i + 1]));
+    vecVHGen.push_back(ZVarHisto("ptt", new TH2D("h_ytptt_cs", "y top, pT top", bins_ptt.size() - 1, &bins_ptt[0], bins_yt.size() - 1, &bins_yt[0]), "ayt", "h_ytptt%d_cs"));
   }
   {
     // [mtt,yt]
     std::vector<double> bins_mtt = {340.,400.,500.,650.,1500.};
     std::vector<double> bins_yt = {0.,0.35,0.85,1.45,2.50};
-    for(int i = 0; i < bins_mtt.size() - 1; i++)
-      vecVHGen.push_back(ZVarHisto("ayt", new TH1D(TString::Format("h_mttyt%d_cs", i + 1), "M ttbar, |y| top", bins_yt.size() - 1, &bins_yt[0]), "mtt", bins_mtt[i], bins_mtt[i + 1]));
+    vecVHGen.push_back(ZVarHisto("ayt", new TH2D("h_mttyt_cs", "M ttbar, |y| top", bins_yt.size() - 1, &bins_yt[0], bins_mtt.size() - 1, &bins_mtt[0]), "mtt", "h_mttyt%d_cs"));
   }
   {
     // [mtt,ytt]
     std::vector<double> bins_mtt = {340.,400.,500.,650.,1500.};
     std::vector<double> bins_ytt = {0.,0.35,0.75,1.15,2.50};
-    for(int i = 0; i < bins_mtt.size() - 1; i++)
-      vecVHGen.push_back(ZVarHisto("aytt", new TH1D(TString::Format("h_mttytt%d_cs", i + 1), "M ttbar, |y| ttbar", bins_ytt.size() - 1, &bins_ytt[0]), "mtt", bins_mtt[i], bins_mtt[i + 1]));
+    vecVHGen.push_back(ZVarHisto("aytt", new TH2D("h_mttytt_cs", "M ttbar, |y| ttbar", bins_ytt.size() - 1, &bins_ytt[0], bins_mtt.size() - 1, &bins_mtt[0]), "mtt", "h_mttytt%d_cs"));
   }
   {
     // [mtt,detatt]
     std::vector<double> bins_mtt = {340.,400.,500.,650.,1500.};
     std::vector<double> bins_detatt = {0.0,0.4,1.2,6.0};
-    for(int i = 0; i < bins_mtt.size() - 1; i++)
-      vecVHGen.push_back(ZVarHisto("detatt", new TH1D(TString::Format("h_mttdetatt%d_cs", i + 1), "M ttbar, delta_eta(t,tbar)", bins_detatt.size() - 1, &bins_detatt[0]), "mtt", bins_mtt[i], bins_mtt[i + 1]));
+    vecVHGen.push_back(ZVarHisto("detatt", new TH2D("h_mttdetatt_cs", "M ttbar, delta_eta(t,tbar)", bins_detatt.size() - 1, &bins_detatt[0], bins_mtt.size() - 1, &bins_mtt[0]), "mtt", "h_mttdetatt%d_cs"));
   }
   {
     // [mtt,dphitt]
     std::vector<double> bins_mtt = {340.,400.,500.,650.,1500.};
     std::vector<double> bins_dphitt = {0.0,2.2,2.95,TMath::Pi()+0.00001};
-    for(int i = 0; i < bins_mtt.size() - 1; i++)
-      vecVHGen.push_back(ZVarHisto("dphitt", new TH1D(TString::Format("h_mttdphitt%d_cs", i + 1), "M ttbar, delta_phi(t,tbar)", bins_dphitt.size() - 1, &bins_dphitt[0]), "mtt", bins_mtt[i], bins_mtt[i + 1]));
+    vecVHGen.push_back(ZVarHisto("dphitt", new TH2D("h_mttdphitt_cs", "M ttbar, delta_phi(t,tbar)", bins_dphitt.size() - 1, &bins_dphitt[0], bins_mtt.size() - 1, &bins_mtt[0]), "mtt", "h_mttdphitt%d_cs"));
   }
   {
     // [mtt,pttt]
     std::vector<double> bins_mtt = {340.,400.,500.,650.,1500.};
     std::vector<double> bins_pttt = {0.,30.,75.,150.,500.};
-    for(int i = 0; i < bins_mtt.size() - 1; i++)
-      vecVHGen.push_back(ZVarHisto("pttt", new TH1D(TString::Format("h_mttpttt%d_cs", i + 1), "M ttbar, pT(ttbar)", bins_pttt.size() - 1, &bins_pttt[0]), "mtt", bins_mtt[i], bins_mtt[i + 1]));
+    vecVHGen.push_back(ZVarHisto("pttt", new TH2D("h_mttpttt_cs", "M ttbar, pT(ttbar)", bins_pttt.size() - 1, &bins_pttt[0], bins_mtt.size() - 1, &bins_mtt[0]), "mtt", "h_mttpttt%d_cs"));
   }
 
   // for reconstruction level the same binning is needed
@@ -122,129 +142,138 @@ int main(int argc, char** argv)
   // (here you can add more reconstruction level histograms)
   vecVH.push_back(ZVarHisto("ptl", new TH1D("h_ptl", "pT leptons", 23, 30.0, 260.0)));
   
-  // loop over decay channels (ch = 1 ee, ch = 2 mumu, ch = 3 emu)
-  for(int ch = 1; ch <= 3; ch++)
+  // 
+  // below similar pieces of code come for data and several MC samples, 
+  // detailed description is given for the first piece, while later on 
+  // only new features are described
+  //
+  // *****************************************
+  // **************** DATA *******************
+  // *****************************************
+  // loop over decay channels (ch = 1 ee, ch = 2 mumu, ch = 3 emu):
+  // data of each channel come from separate primary datasets
+  for(int ch = 1; ch <= 3 && flagData; ch++)
   {
     //if(ch != 3) continue; // if you need only emu (for test purpose e.g.)
-    // 
-    // below similar pieces of code come for data and several MC samples, 
-    // detailed description is given for the first piece, while later on 
-    // only new features are described
-    //
-    // *****************************************
-    // **************** DATA *******************
-    // *****************************************
-    if(flagData)
+    // ZEventRecoInput is a class for event reconstruction, see its description in eventReco.h
+    ZEventRecoInput in;
+    //in.MaxNEvents = 100; // if you need to limit the number of processed events
+    in.NThreads = nThreads; // number of threads (see above)
+    //in.KinRecoBlock = 256; // if you need kinematic reconstruction in batches of selected events (see kinRecoBatch.h)
+    //in.KinRecoCache = true; // if you need to store selection and kinreco results and refill histograms from them later (see kinRecoCache.h)
+    //in.UseSkim = true; // if you need to store preselected events and read them instead of the full ntuples later (see skim.h)
+    //in.UsePreselIndex = true; // if you need to read only candidate events using per file preselection index (see preselIndex.h)
+    //in.CutFlow = 2; // if you need reco level cut flow (1) and adaptive order of cuts (2) (see cutFlow.h)
+    in.Name = "data"; // name pattern for output histograms
+    in.Type = 1; // type = 1 for data, 2 for MC signal, 3 for MC 'ttbar other', 4 for the rest of MC background samples
+    in.Channel = ch; // decay channel
+    in.VecVarHisto = vecVH; // copy (cheap: histograms are shared prototypes, instantiated in eventreco)
+    // input ROOT ntuples
+    if(ch == 1) // ee
     {
-      // ZEventRecoInput is a class for event reconstruction, see its description in eventReco.h
-      ZEventRecoInput in;
-      //in.MaxNEvents = 100; // if you need to limit the number of processed events
-      in.Name = "data"; // name pattern for output histograms
-      in.Type = 1; // type = 1 for data, 2 for MC signal, 3 for MC 'ttbar other', 4 for the rest of MC background samples
-      in.Channel = ch; // decay channel
-      in.VecVarHisto = vecVH; // need to copy it, because further will be changed
-      // input ROOT ntuples
-      if(ch == 1) // ee
-      {
-        in.AddToChain(dataDir + "/DoubleElectron/*.root");
-        in.AddToChain(dataDir + "/DoubleElectron-RunC/*.root");
-      }
-      else if(ch == 2) // mumu
-      {
-        in.AddToChain(dataDir + "/DoubleMuParked/*.root");
-        in.AddToChain(dataDir + "/DoubleMuParked-RunC/*.root");
-      }
-      else if(ch == 3) // emu
-      {
-        in.AddToChain(dataDir + "/MuEG/*.root");
-        in.AddToChain(dataDir + "/MuEG-RunC/*.root");
-      }
-      // main part: event reconstruction call
-      eventreco(in);
+      in.AddToChain(dataDir + "/DoubleElectron/*.root");
+      in.AddToChain(dataDir + "/DoubleElectron-RunC/*.root");
     }
-    
-    // *****************************************
-    // ************** MC signal ****************
-    // *****************************************
-    //
-    // MC event weights need to be changed to most precise theoretical predictions, 
-    // the formula is:
-    // weight = lumi / (nevents / sigma_MC) * (sigma_theory / sigma_MC) = lumi * nevents / sigma_theory
-    //
-    // Number of events can be obtained from webpage (see http://opendata.cern.ch/collection/CMS-Simulated-Datasets), 
-    // but it should be checked that all events have been processed at the Analyzer step (see end of log files)
-    //
-    // MC cross section can be obtained from any ROOT file in the mC sample: open the ROOT file, create TBrowser, navigate to
-    // Runs -> GenRunInfoProduct_generator__SIM. -> GenRunInfoProduct_generator__SIM.obj -> InternalXSec -> value_
-    // (nevertheless sigma_MC cancels)
-    //
-    // number of events: 62131965
-    // MC cross section theory: 245.8
-    // weight: 9850.0 / 62131965 * 245.8 = 0.038967543
-    if(flagMCsig)
+    else if(ch == 2) // mumu
     {
-      // MC signal reco level
-      ZEventRecoInput in;
-      //in.MaxNEvents = 1000;
-      in.Weight = 0.038967543; // weight (see above)
-      in.Name = "mcSigReco";
-      in.Type = 2;
-      in.Channel = ch;
-      in.VecVarHisto = vecVH;
-      in.AddToChain(mcDir + "/TTJets_MSDecays_central_TuneZ2star_8TeV-madgraph-tauola/*.root");
-      eventreco(in);
-      // MC ttbar other (background): re-use existing ZEventRecoInput, just change type
-      in.Name = "mcSigOtherReco";
-      in.Type = 3;
-      eventreco(in);
-      // MC ttbar signal, generator level: again re-use existing ZEventRecoInput, change type and set proper flag (see below)
-      in.Name = "mcSigGen";
-      in.Type = 2;
-      in.VecVarHisto = vecVHGen;
-      in.Gen = true; // flag to notify that generator level should be processed
-      eventreco(in);
+      in.AddToChain(dataDir + "/DoubleMuParked/*.root");
+      in.AddToChain(dataDir + "/DoubleMuParked-RunC/*.root");
     }
-    // *****************************************
-    // ************ MC single top **************
-    // *****************************************
-    // number of events: XXX
-    // MC cross section theory: 11.1 (times factor 2 because there is top and antitop)
-    // weight: 9850.0 / (497658 + 493460) * 11.1 * 2 = 0.2206
-    if(flagMCstop)
+    else if(ch == 3) // emu
     {
-      ZEventRecoInput in;
-      //in.MaxNEvents = 1000;
-      in.Name = "mcSingleTopReco";
-      in.Type = 4;
-      in.Weight = 0.2206;
-      in.Channel = ch;
-      in.VecVarHisto = vecVH;
-      in.AddToChain(mcDir + "/Tbar_tW-channel-DR_TuneZ2star_8TeV-powheg-tauola/*.root");
-      in.AddToChain(mcDir + "/T_tW-channel-DR_TuneZ2star_8TeV-powheg-tauola/*.root");
-      eventreco(in);
+      in.AddToChain(dataDir + "/MuEG/*.root");
+      in.AddToChain(dataDir + "/MuEG-RunC/*.root");
     }
-    // *****************************************
-    // **************** MC DY ******************
-    // *****************************************
-    // only high mass DY sample is included
-    // Events: 30458871
-    // MC cross section theory: 3503.71 (multiplied by Z -> ll branching ratio)
-    // weight: 9850.0 / 30458871 * 3503.71 = 1.13305393
-    if(flagMCdy)
+    // main part: event reconstruction call
+    eventreco(in);
+  }
+  
+  // For MC samples all decay channels are processed in one event loop: 
+  // instead of setting Name, Type, Channel and VecVarHisto of ZEventRecoInput, 
+  // one output per channel (and per type for signal MC) is added with 
+  // AddOutput(name, channel, type, gen, histograms), so the input ntuples 
+  // are read only once (see eventReco.h)
+  //
+  // *****************************************
+  // ************** MC signal ****************
+  // *****************************************
+  //
+  // MC event weights need to be changed to most precise theoretical predictions, 
+  // the formula is:
+  // weight = lumi / (nevents / sigma_MC) * (sigma_theory / sigma_MC) = lumi * nevents / sigma_theory
+  //
+  // Number of events can be obtained from webpage (see http://opendata.cern.ch/collection/CMS-Simulated-Datasets), 
+  // but it should be checked that all events have been processed at the Analyzer step (see end of log files)
+  //
+  // MC cross section can be obtained from any ROOT file in the mC sample: open the ROOT file, create TBrowser, navigate to
+  // Runs -> GenRunInfoProduct_generator__SIM. -> GenRunInfoProduct_generator__SIM.obj -> InternalXSec -> value_
+  // (nevertheless sigma_MC cancels)
+  //
+  // number of events: 62131965
+  // MC cross section theory: 245.8
+  // weight: 9850.0 / 62131965 * 245.8 = 0.038967543
+  if(flagMCsig)
+  {
+    ZEventRecoInput in;
+    //in.MaxNEvents = 1000;
+    in.NThreads = nThreads;
+    in.Weight = 0.038967543; // weight (see above), used for all outputs
+    in.Name = "mcSig";
+    in.AddToChain(mcDir + "/TTJets_MSDecays_central_TuneZ2star_8TeV-madgraph-tauola/*.root");
+    for(int ch = 1; ch <= 3; ch++)
     {
-      ZEventRecoInput in;
-      //in.MaxNEvents = 1000;
-      in.Type = 4;
-      in.Channel = ch;
-      in.VecVarHisto = vecVH;
-      in.Name = "mcDYhmReco";
-      in.Weight = 1.13305393;
-      in.ClearChain();
-      in.AddToChain(mcDir + "/DYJetsToLL_M-50_TuneZ2Star_8TeV-madgraph-tarball/*.root");
-      eventreco(in);
+      // MC signal reco level
+      in.AddOutput("mcSigReco", ch, 2, false, vecVH);
+      // MC ttbar other (background): type 3
+      in.AddOutput("mcSigOtherReco", ch, 3, false, vecVH);
+      // MC ttbar signal, generator level: type 2 with flag to notify that generator level should be processed
+      in.AddOutput("mcSigGen", ch, 2, true, vecVHGen);
     }
+    eventreco(in);
+  }
+  // *****************************************
+  // ************ MC single top **************
+  // *****************************************
+  // number of events: XXX
+  // MC cross section theory: 11.1 (times factor 2 because there is top and antitop)
+  // weight: 9850.0 / (497658 + 493460) * 11.1 * 2 = 0.2206
+  if(flagMCstop)
+  {
+    ZEventRecoInput in;
+    //in.MaxNEvents = 1000;
+    in.NThreads = nThreads;
+    in.Name = "mcSingleTop";
+    in.Weight = 0.2206;
+    in.AddToChain(mcDir + "/Tbar_tW-channel-DR_TuneZ2star_8TeV-powheg-tauola/*.root");
+    in.AddToChain(mcDir + "/T_tW-channel-DR_TuneZ2star_8TeV-powheg-tauola/*.root");
+    for(int ch = 1; ch <= 3; ch++)
+      in.AddOutput("mcSingleTopReco", ch, 4, false, vecVH);
+    eventreco(in);
+  }
+  // *****************************************
+  // **************** MC DY ******************
+  // *****************************************
+  // only high mass DY sample is included
+  // Events: 30458871
+  // MC cross section theory: 3503.71 (multiplied by Z -> ll branching ratio)
+  // weight: 9850.0 / 30458871 * 3503.71 = 1.13305393
+  if(flagMCdy)
+  {
+    ZEventRecoInput in;
+    //in.MaxNEvents = 1000;
+    in.NThreads = nThreads;
+    in.Name = "mcDYhm";
+    in.Weight = 1.13305393;
+    in.ClearChain();
+    in.AddToChain(mcDir + "/DYJetsToLL_M-50_TuneZ2Star_8TeV-madgraph-tarball/*.root");
+    for(int ch = 1; ch <= 3; ch++)
+      in.AddOutput("mcDYhmReco", ch, 4, false, vecVH);
+    eventreco(in);
   }
 
+  KinRecoRecordClose();
+  if(gKinRecoLandau == kLandauValidate)
+    KinRecoLandauValidationPrint();
   return 0;
 }
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
@@ -0,0 +1,143 @@
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// This code writes synthetic ttbar ntuples (see synthEvent.h) with the
+// same tree layout as the ntuples produced by Analyzer, for scale and
+// load tests of ttbarMakeHist (e.g. 10 or 100 times more events than in
+// the real samples) and to reproduce performance problems
+// deterministically without the real ntuples:
+//   ./ttbarMakeNtuples [name=value ...]
+// with the following settings (default values in brackets):
+//   dir     output directory [ntuples-synth]
+//   events  total number of events [1000000]
+//   files   number of files [10]
+//   mix     relative fractions of ee, mumu, emu and other ttbar events [1,1,2,77]
+//   jets    mean number of extra jets [2]
+//   leptons mean number of extra leptons [1]
+//   pileup  mean number of pile-up interactions [10]
+//   mc      1 to write MC truth branches (mcEventType, mcT, mcTbar), 0 for data-like ntuples [1]
+//   seed    random generator seed [4357]
+// Files are named synth_000.root, synth_001.root, ... (tree "tree"),
+// file number f is generated with seed + f, so the files are
+// reproducible and each of them can be regenerated separately. The
+// default channel mix corresponds to ttbar decays (electrons and muons
+// only, taus are not generated).
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// additional files from this analysis (look there for description)
+#include "synthEvent.h"
+// C++ library or ROOT header files
+#include <cstdlib>
+#include <sys/stat.h>
+#include <TFile.h>
+#include <TTree.h>
+#include <TString.h>
+#include <TStopwatch.h>
+
+// parse argument name=value, returns true if the argument has provided name
+bool ParseArg(const char* arg, const char* name, TString& value)
+{
+  const TString str = arg;
+  const TString prefix = TString(name) + "=";
+  if(!str.BeginsWith(prefix))
+    return false;
+  value = str(prefix.Length(), str.Length() - prefix.Length());
+  return true;
+}
+
+int main(int argc, char** argv)
+{
+  // settings
+  TString dir = "ntuples-synth";
+  long nEvents = 1000000;
+  int nFiles = 10;
+  double mix[4] = { 1.0, 1.0, 2.0, 77.0 };
+  ZSynthSettings settings;
+  settings.PileUp = 10.0;
+  bool flagMC = true;
+  int seed = 4357;
+  for(int a = 1; a < argc; a++)
+  {
+    TString value;
+    if(ParseArg(argv[a], "dir", value))
+      dir = value;
+    else if(ParseArg(argv[a], "events", value))
+      nEvents = atol(value.Data());
+    else if(ParseArg(argv[a], "files", value))
+      nFiles = atoi(value.Data());
+    else if(ParseArg(argv[a], "mix", value) && sscanf(value.Data(), "%lf,%lf,%lf,%lf", &mix[0], &mix[1], &mix[2], &mix[3]) == 4)
+      ;
+    else if(ParseArg(argv[a], "jets", value))
+      settings.NExtraJets = atof(value.Data());
+    else if(ParseArg(argv[a], "leptons", value))
+      settings.NExtraLep = atof(value.Data());
+    else if(ParseArg(argv[a], "pileup", value))
+      settings.PileUp = atof(value.Data());
+    else if(ParseArg(argv[a], "mc", value))
+      flagMC = atoi(value.Data());
+    else if(ParseArg(argv[a], "seed", value))
+      seed = atoi(value.Data());
+    else
+    {
+      printf("Error: unknown argument %s\n", argv[a]);
+      printf("Usage: %s [dir=...] [events=...] [files=...] [mix=ee,mumu,emu,other] [jets=...] [leptons=...] [pileup=...] [mc=0/1] [seed=...]\n", argv[0]);
+      return 1;
+    }
+  }
+  const double mixSum = mix[0] + mix[1] + mix[2] + mix[3];
+  if(nEvents <= 0 || nFiles <= 0 || mix[0] < 0.0 || mix[1] < 0.0 || mix[2] < 0.0 || mix[3] < 0.0 || mixSum <= 0.0)
+  {
+    printf("Error: wrong settings (events = %ld, files = %d, mix = %.3f,%.3f,%.3f,%.3f)\n", nEvents, nFiles, mix[0], mix[1], mix[2], mix[3]);
+    return 1;
+  }
+  printf("dir: %s   events: %ld   files: %d   mix (ee,mumu,emu,other): %.3f,%.3f,%.3f,%.3f\n", dir.Data(), nEvents, nFiles, mix[0], mix[1], mix[2], mix[3]);
+  printf("extra jets: %.2f   extra leptons: %.2f   pile-up: %.2f   MC: %d   seed: %d\n", settings.NExtraJets, settings.NExtraLep, settings.PileUp, flagMC, seed);
+  // output directory (with parent directories)
+  for(int i = 1; i < dir.Length(); i++)
+    if(dir[i] == '/')
+      mkdir(TString(dir(0, i)).Data(), 0755);
+  mkdir(dir.Data(), 0755);
+
+  // cumulative channel fractions: ee, mumu, emu, other
+  const int channels[4] = { 1, 2, 3, 0 };
+  double cumMix[4];
+  for(int c = 0; c < 4; c++)
+    cumMix[c] = (c ? cumMix[c - 1] : 0.0) + mix[c] / mixSum;
+
+  // generate files (events are numbered consecutively over all files)
+  ZTree tree(flagMC);
+  ZSynthEvent ev;
+  long nType[4] = { 0, 0, 0, 0 };
+  long event = 0;
+  TStopwatch timer;
+  for(int f = 0; f < nFiles; f++)
+  {
+    const long nFileEvents = nEvents / nFiles + (f < nEvents % nFiles);
+    const TString fileName = TString::Format("%s/synth_%03d.root", dir.Data(), f);
+    TFile* file = TFile::Open(fileName, "recreate");
+    if(!file || file->IsZombie())
+    {
+      printf("Error: can not write %s\n", fileName.Data());
+      exit(1);
+    }
+    TTree* out = new TTree("tree", "ttbar"); // owned by file
+    SynthBookBranches(out, &tree, flagMC);
+    TRandom3 rnd(seed + f);
+    for(long e = 0; e < nFileEvents; e++, event++)
+    {
+      const double r = rnd.Rndm();
+      int c = 0;
+      while(c < 3 && r >= cumMix[c])
+        c++;
+      SynthTTbarEvent(rnd, channels[c], settings, ev);
+      SynthFillTree(rnd, ev, settings, 1, event, &tree);
+      out->Fill();
+      nType[channels[c]]++;
+    }
+    out->Write();
+    file->Close();
+    delete file;
+    printf("%s: %ld events\n", fileName.Data(), nFileEvents);
+  }
+  printf("events: %ld (ee: %ld, mumu: %ld, emu: %ld, other: %ld)   time: %.1f s\n", event, nType[1], nType[2], nType[3], nType[0], timer.RealTime());
+  return 0;
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
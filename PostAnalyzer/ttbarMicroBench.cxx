@@ -0,0 +1,230 @@
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// This code benchmarks the hot functions of the analysis in isolation
+// on synthetic ttbar events (see synthEvent.h), no ntuples are needed:
+//   ./ttbarMicroBench [number of events] [mean number of extra jets] [jet smearing] [seed]
+// For each function the time per call, the number of heap allocations
+// per call and the throughput are printed: lepton selection (SelectEl(),
+// SelectMu()), dilepton selection (SelectDilepEE(), SelectDilepMuMu(),
+// SelectDilepEMu()), jet selection (SelectJets()), kinematic
+// reconstruction for the true b jets (SolveKinRecoDilepton()) and for all
+// jets (KinRecoDilepton()), and histogram filling (FillHistos(), own
+// histograms and histogram bank). Events are generated with a fixed seed
+// before the benchmarks, so the numbers are reproducible.
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// additional files from this analysis (look there for description)
+#include "synthEvent.h"
+#include "eventReco.h"
+// C++ library or ROOT header files
+#include <new>
+#include <cstdlib>
+#include <TStopwatch.h>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>> Allocation counter >>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// all heap allocations of this program go through operator new (benchmarks are single threaded)
+long gNAlloc = 0;
+
+void* operator new(size_t size)
+{
+  gNAlloc++;
+  void* p = malloc(size ? size : 1);
+  if(!p)
+    throw std::bad_alloc();
+  return p;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>> Measurement >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// synthetic input: generated events and their ntuple variables
+struct ZBenchInput
+{
+  std::vector<ZSynthEvent> Events;
+  std::vector<ZTree> Trees;
+};
+
+// result checksum (printed, so that the measured calls are not optimised away)
+double gChecksum = 0.0;
+
+// run bench(input) nPasses times and print time, allocations and throughput per call
+// (bench returns the number of calls of the measured function in one pass)
+template<class Bench>
+void Measure(const char* name, const ZBenchInput& input, const int nPasses, Bench bench)
+{
+  // warm up (first pass is not measured)
+  bench(input);
+  const long nAlloc0 = gNAlloc;
+  long nCalls = 0;
+  TStopwatch timer;
+  for(int pass = 0; pass < nPasses; pass++)
+    nCalls += bench(input);
+  timer.Stop();
+  const long nAlloc = gNAlloc - nAlloc0;
+  const double t = timer.RealTime();
+  if(nCalls == 0)
+  {
+    printf("%-28s no calls\n", name);
+    return;
+  }
+  printf("%-28s %10ld calls %10.1f ns/call %8.3f allocs/call %12.4g calls/s\n", name, nCalls, 1e9 * t / nCalls,
+         double(nAlloc) / nCalls, (t > 0.0) ? (nCalls / t) : 0.0);
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>> Benchmarks >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// lepton selection: one call per lepton candidate
+long BenchSelectEl(const ZBenchInput& input)
+{
+  long nCalls = 0;
+  for(size_t e = 0; e < input.Trees.size(); e++)
+    for(int el = 0; el < input.Trees[e].Nel; el++, nCalls++)
+      gChecksum += SelectEl(&input.Trees[e], el);
+  return nCalls;
+}
+long BenchSelectMu(const ZBenchInput& input)
+{
+  long nCalls = 0;
+  for(size_t e = 0; e < input.Trees.size(); e++)
+    for(int mu = 0; mu < input.Trees[e].Nmu; mu++, nCalls++)
+      gChecksum += SelectMu(&input.Trees[e], mu);
+  return nCalls;
+}
+
+// dilepton selection: one call per event
+template<void (*SelectDilep)(const ZTree*, ZFourVector&, ZFourVector&, double&)>
+long BenchSelectDilep(const ZBenchInput& input)
+{
+  for(size_t e = 0; e < input.Trees.size(); e++)
+  {
+    ZFourVector vecLepM, vecLepP;
+    double maxPtDiLep = -1.0;
+    SelectDilep(&input.Trees[e], vecLepM, vecLepP, maxPtDiLep);
+    gChecksum += maxPtDiLep;
+  }
+  return input.Trees.size();
+}
+
+// jet selection: one call per event
+long BenchSelectJets(const ZBenchInput& input)
+{
+  ZJet vecJets[ZTree::maxNjet];
+  for(size_t e = 0; e < input.Trees.size(); e++)
+  {
+    bool oneBTagJet = false;
+    gChecksum += SelectJets(&input.Trees[e], 0.244, vecJets, oneBTagJet);
+  }
+  return input.Trees.size();
+}
+
+// kinematic reconstruction for the true b and bbar jets: one call per event
+long BenchSolveKinReco(const ZBenchInput& input)
+{
+  for(size_t e = 0; e < input.Events.size(); e++)
+  {
+    const ZSynthEvent& ev = input.Events[e];
+    ZSolutionKinRecoDilepton sol;
+    if(SolveKinRecoDilepton(ev.LepM, ev.LepP, ev.B, ev.Bbar, ev.MetX, ev.MetY, sol))
+      gChecksum += sol.zT.E;
+  }
+  return input.Events.size();
+}
+
+// kinematic reconstruction with all jets: one call per event
+long BenchKinReco(const ZBenchInput& input)
+{
+  for(size_t e = 0; e < input.Events.size(); e++)
+  {
+    const ZSynthEvent& ev = input.Events[e];
+    ZFourVector t, tbar;
+    if(KinRecoDilepton(ev.LepM, ev.LepP, ev.Jets, ev.NJets, ev.MetX, ev.MetY, t, tbar))
+      gChecksum += t.E;
+  }
+  return input.Events.size();
+}
+
+// histogram filling (generated top and antitop, smeared leptons): one call per event,
+// own histograms (bank = NULL) or histogram bank
+long BenchFillHistos(const ZBenchInput& input, std::vector<ZVarHisto>& vecVH, ZHistoBank* bank)
+{
+  for(size_t e = 0; e < input.Events.size(); e++)
+  {
+    const ZSynthEvent& ev = input.Events[e];
+    FillHistos(vecVH, 1.0, SynthFourVector(ev.T), SynthFourVector(ev.Tbar), ev.LepM, ev.LepP, bank);
+  }
+  return input.Events.size();
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>> Main function >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+int main(int argc, char** argv)
+{
+  // settings
+  const int nEvents = (argc > 1) ? atoi(argv[1]) : 10000;
+  ZSynthSettings settings;
+  if(argc > 2)
+    settings.NExtraJets = atof(argv[2]);
+  if(argc > 3)
+    settings.JetSmear = atof(argv[3]);
+  const int seed = (argc > 4) ? atoi(argv[4]) : 4357;
+  const int nPasses = 5;
+  if(nEvents <= 0)
+  {
+    printf("Usage: %s [number of events] [mean number of extra jets] [jet smearing] [seed]\n", argv[0]);
+    return 1;
+  }
+  printf("events: %d   extra jets: %.2f   jet smearing: %.3f   seed: %d   passes: %d\n", nEvents, settings.NExtraJets, settings.JetSmear, seed, nPasses);
+
+  // synthetic input (channels ee, mumu, emu in turn)
+  TRandom3 rnd(seed);
+  ZBenchInput input;
+  input.Events.resize(nEvents);
+  input.Trees.resize(nEvents, ZTree(true));
+  for(int e = 0; e < nEvents; e++)
+  {
+    SynthTTbarEvent(rnd, 1 + e % 3, settings, input.Events[e]);
+    SynthFillTree(rnd, input.Events[e], settings, 1, e, &input.Trees[e]);
+  }
+
+  // histograms as in ttbarMakeHist.cxx (some of them)
+  TH1::SetDefaultSumw2();
+  std::vector<ZVarHisto> vecVH;
+  vecVH.push_back(ZVarHisto("ptt", new TH1D("h_ptt", "pT top", 20, 0.0, 400.0)));
+  vecVH.push_back(ZVarHisto("pttat", new TH1D("h_pttat", "pT tatop", 20, 0.0, 400.0)));
+  vecVH.push_back(ZVarHisto("yt", new TH1D("h_yt", "y top", 26, -2.6, 2.6)));
+  vecVH.push_back(ZVarHisto("ytt", new TH1D("h_ytt", "y ttbar", 26, -2.6, 2.6)));
+  vecVH.push_back(ZVarHisto("mtt", new TH1D("h_mtt", "M ttbar", 30, 300.0, 1500.0)));
+  vecVH.push_back(ZVarHisto("ptl", new TH1D("h_ptl", "pT lepton", 20, 0.0, 400.0)));
+  ZHistoBank bank;
+  for(int h = 0; h < vecVH.size(); h++)
+  {
+    vecVH[h].Instantiate();
+    vecVH[h].Book(bank);
+  }
+
+  // benchmarks
+  Measure("SelectEl", input, nPasses, BenchSelectEl);
+  Measure("SelectMu", input, nPasses, BenchSelectMu);
+  Measure("SelectDilepEE", input, nPasses, BenchSelectDilep<SelectDilepEE>);
+  Measure("SelectDilepMuMu", input, nPasses, BenchSelectDilep<SelectDilepMuMu>);
+  Measure("SelectDilepEMu", input, nPasses, BenchSelectDilep<SelectDilepEMu>);
+  Measure("SelectJets", input, nPasses, BenchSelectJets);
+  Measure("SolveKinRecoDilepton", input, nPasses, BenchSolveKinReco);
+  Measure("KinRecoDilepton", input, nPasses, BenchKinReco);
+  Measure("FillHistos", input, nPasses, [&vecVH](const ZBenchInput& in) { return BenchFillHistos(in, vecVH, NULL); });
+  Measure("FillHistos (bank)", input, nPasses, [&vecVH, &bank](const ZBenchInput& in) { return BenchFillHistos(in, vecVH, &bank); });
+  printf("checksum: %e\n", gChecksum);
+  return 0;
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>